@@ -9,12 +9,105 @@
 #define _OSG_GLEXTENSIONS_H_
 
 #include <osg/GLExtensions>
+#include <osg/buffered_value>
 #include <osg/Version>
 
 #ifndef GL_TEXTURE_MAX_LEVEL
   #define GL_TEXTURE_MAX_LEVEL 0x813D
 #endif
 
+#ifndef GL_TEXTURE_2D_ARRAY
+  #define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+
+#ifndef GL_TEXTURE_2D_MULTISAMPLE_ARRAY
+  #define GL_TEXTURE_2D_MULTISAMPLE_ARRAY 0x9102
+#endif
+
+#ifndef GL_DEPTH_COMPONENT32F
+  #define GL_DEPTH_COMPONENT32F 0x8CAC
+#endif
+
+#ifndef GL_DEPTH_STENCIL_ATTACHMENT
+  #define GL_DEPTH_STENCIL_ATTACHMENT 0x821A
+#endif
+
+#ifndef GL_DEPTH_COMPONENT16
+  #define GL_DEPTH_COMPONENT16 0x81A5
+#endif
+
+#ifndef GL_DEPTH24_STENCIL8
+  #define GL_DEPTH24_STENCIL8 0x88F0
+#endif
+
+#ifndef GL_SRGB8_ALPHA8
+  #define GL_SRGB8_ALPHA8 0x8C43
+#endif
+
+#ifndef GL_RGBA16F
+  #define GL_RGBA16F 0x881A
+#endif
+
+#ifndef GL_R11F_G11F_B10F
+  #define GL_R11F_G11F_B10F 0x8C3A
+#endif
+
+#ifndef GL_TIMESTAMP
+  #define GL_TIMESTAMP 0x8E28
+#endif
+
+#ifndef GL_QUERY_RESULT
+  #define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+  #define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+#ifndef GL_UNIFORM_BUFFER
+  #define GL_UNIFORM_BUFFER 0x8A11
+#endif
+
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  #define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+
+#ifndef GL_MAP_WRITE_BIT
+  #define GL_MAP_WRITE_BIT 0x0002
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+  #define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+  #define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_MAP_READ_BIT
+  #define GL_MAP_READ_BIT 0x0001
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+  #define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+  #define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+  #define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_ALREADY_SIGNALED
+  #define GL_ALREADY_SIGNALED 0x911A
+#endif
+
+#ifndef GL_CONDITION_SATISFIED
+  #define GL_CONDITION_SATISFIED 0x911C
+#endif
+
 #if (OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0))
 typedef osg::GLExtensions OSG_GLExtensions;
 typedef osg::GLExtensions OSG_Texture_Extensions;
@@ -38,4 +131,142 @@ inline const OSG_Texture_Extensions* getTextureExtensions(const osg::State& stat
 #endif
 }
 
+// Entry points which are not exposed through the OpenSceneGraph extension objects
+struct OculusGLExtensions : public osg::Referenced {
+  explicit OculusGLExtensions(unsigned int contextID) {
+    osg::setGLExtensionFuncPtr(glFramebufferTextureMultiviewOVR,
+                               "glFramebufferTextureMultiviewOVR");
+    osg::setGLExtensionFuncPtr(glFramebufferTexture,
+                               "glFramebufferTexture",
+                               "glFramebufferTextureARB");
+    osg::setGLExtensionFuncPtr(glTexImage3DMultisample, "glTexImage3DMultisample");
+    osg::setGLExtensionFuncPtr(glGenQueries, "glGenQueries", "glGenQueriesARB");
+    osg::setGLExtensionFuncPtr(glDeleteQueries, "glDeleteQueries", "glDeleteQueriesARB");
+    osg::setGLExtensionFuncPtr(glQueryCounter, "glQueryCounter");
+    osg::setGLExtensionFuncPtr(glGetQueryObjectiv,
+                               "glGetQueryObjectiv",
+                               "glGetQueryObjectivARB");
+    osg::setGLExtensionFuncPtr(glGetQueryObjectui64v,
+                               "glGetQueryObjectui64v",
+                               "glGetQueryObjectui64vEXT");
+    osg::setGLExtensionFuncPtr(glGenBuffers, "glGenBuffers", "glGenBuffersARB");
+    osg::setGLExtensionFuncPtr(glDeleteBuffers, "glDeleteBuffers", "glDeleteBuffersARB");
+    osg::setGLExtensionFuncPtr(glBindBuffer, "glBindBuffer", "glBindBufferARB");
+    osg::setGLExtensionFuncPtr(glBindBufferRange, "glBindBufferRange");
+    osg::setGLExtensionFuncPtr(glBufferStorage, "glBufferStorage");
+    osg::setGLExtensionFuncPtr(glMapBufferRange, "glMapBufferRange");
+    osg::setGLExtensionFuncPtr(glUnmapBuffer, "glUnmapBuffer", "glUnmapBufferARB");
+    osg::setGLExtensionFuncPtr(glInvalidateFramebuffer, "glInvalidateFramebuffer");
+    osg::setGLExtensionFuncPtr(glInvalidateNamedFramebufferData,
+                               "glInvalidateNamedFramebufferData");
+    osg::setGLExtensionFuncPtr(glBlitNamedFramebuffer, "glBlitNamedFramebuffer");
+    osg::setGLExtensionFuncPtr(glFenceSync, "glFenceSync");
+    osg::setGLExtensionFuncPtr(glClientWaitSync, "glClientWaitSync");
+    osg::setGLExtensionFuncPtr(glDeleteSync, "glDeleteSync");
+
+    isMultiviewSupported = osg::isGLExtensionSupported(contextID, "GL_OVR_multiview2") &&
+                           glFramebufferTextureMultiviewOVR != nullptr;
+    isLayeredRenderingSupported = glFramebufferTexture != nullptr;
+    isTimerQuerySupported =
+      osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_timer_query", 3.3f) &&
+      glGenQueries != nullptr && glDeleteQueries != nullptr && glQueryCounter != nullptr &&
+      glGetQueryObjectiv != nullptr && glGetQueryObjectui64v != nullptr;
+    isPersistentMappingSupported =
+      osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_buffer_storage", 4.4f) &&
+      glGenBuffers != nullptr && glDeleteBuffers != nullptr && glBindBuffer != nullptr &&
+      glBindBufferRange != nullptr && glBufferStorage != nullptr && glMapBufferRange != nullptr &&
+      glUnmapBuffer != nullptr;
+    isInvalidateSupported =
+      osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_invalidate_subdata", 4.3f) &&
+      glInvalidateFramebuffer != nullptr;
+    isDirectStateAccessSupported =
+      osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_direct_state_access", 4.5f) &&
+      glInvalidateNamedFramebufferData != nullptr && glBlitNamedFramebuffer != nullptr;
+    isAsyncReadbackSupported =
+      isPersistentMappingSupported &&
+      osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_sync", 3.2f) &&
+      glFenceSync != nullptr && glClientWaitSync != nullptr && glDeleteSync != nullptr;
+  }
+
+  bool isMultiviewSupported = {false};
+  bool isLayeredRenderingSupported = {false};
+  bool isTimerQuerySupported = {false};
+  bool isPersistentMappingSupported = {false};
+  bool isInvalidateSupported = {false};
+  bool isDirectStateAccessSupported = {false};
+  bool isAsyncReadbackSupported = {false};
+
+  void(GL_APIENTRY* glFramebufferTextureMultiviewOVR)(GLenum target,
+                                                      GLenum attachment,
+                                                      GLuint texture,
+                                                      GLint level,
+                                                      GLint baseViewIndex,
+                                                      GLsizei numViews) = {nullptr};
+  void(GL_APIENTRY* glFramebufferTexture)(GLenum target,
+                                          GLenum attachment,
+                                          GLuint texture,
+                                          GLint level) = {nullptr};
+  void(GL_APIENTRY* glTexImage3DMultisample)(GLenum target,
+                                             GLsizei samples,
+                                             GLenum internalformat,
+                                             GLsizei width,
+                                             GLsizei height,
+                                             GLsizei depth,
+                                             GLboolean fixedsamplelocations) = {nullptr};
+  void(GL_APIENTRY* glGenQueries)(GLsizei n, GLuint* ids) = {nullptr};
+  void(GL_APIENTRY* glDeleteQueries)(GLsizei n, const GLuint* ids) = {nullptr};
+  void(GL_APIENTRY* glQueryCounter)(GLuint id, GLenum target) = {nullptr};
+  void(GL_APIENTRY* glGetQueryObjectiv)(GLuint id, GLenum pname, GLint* params) = {nullptr};
+  void(GL_APIENTRY* glGetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params) = {nullptr};
+  void(GL_APIENTRY* glGenBuffers)(GLsizei n, GLuint* buffers) = {nullptr};
+  void(GL_APIENTRY* glDeleteBuffers)(GLsizei n, const GLuint* buffers) = {nullptr};
+  void(GL_APIENTRY* glBindBuffer)(GLenum target, GLuint buffer) = {nullptr};
+  void(GL_APIENTRY* glBindBufferRange)(GLenum target,
+                                       GLuint index,
+                                       GLuint buffer,
+                                       GLintptr offset,
+                                       GLsizeiptr size) = {nullptr};
+  void(GL_APIENTRY* glBufferStorage)(GLenum target,
+                                     GLsizeiptr size,
+                                     const void* data,
+                                     GLbitfield flags) = {nullptr};
+  void*(GL_APIENTRY* glMapBufferRange)(GLenum target,
+                                       GLintptr offset,
+                                       GLsizeiptr length,
+                                       GLbitfield access) = {nullptr};
+  GLboolean(GL_APIENTRY* glUnmapBuffer)(GLenum target) = {nullptr};
+  void(GL_APIENTRY* glInvalidateFramebuffer)(GLenum target,
+                                             GLsizei numAttachments,
+                                             const GLenum* attachments) = {nullptr};
+  void(GL_APIENTRY* glInvalidateNamedFramebufferData)(GLuint framebuffer,
+                                                      GLsizei numAttachments,
+                                                      const GLenum* attachments) = {nullptr};
+  void(GL_APIENTRY* glBlitNamedFramebuffer)(GLuint readFramebuffer,
+                                            GLuint drawFramebuffer,
+                                            GLint srcX0,
+                                            GLint srcY0,
+                                            GLint srcX1,
+                                            GLint srcY1,
+                                            GLint dstX0,
+                                            GLint dstY0,
+                                            GLint dstX1,
+                                            GLint dstY1,
+                                            GLbitfield mask,
+                                            GLenum filter) = {nullptr};
+  GLsync(GL_APIENTRY* glFenceSync)(GLenum condition, GLbitfield flags) = {nullptr};
+  GLenum(GL_APIENTRY* glClientWaitSync)(GLsync sync,
+                                        GLbitfield flags,
+                                        GLuint64 timeout) = {nullptr};
+  void(GL_APIENTRY* glDeleteSync)(GLsync sync) = {nullptr};
+};
+
+inline const OculusGLExtensions* getOculusGLExtensions(const osg::State& state) {
+  static osg::buffered_object<osg::ref_ptr<OculusGLExtensions> > s_extensions;
+  osg::ref_ptr<OculusGLExtensions>& extensions = s_extensions[state.getContextID()];
+  if (!extensions.valid()) {
+    extensions = new OculusGLExtensions(state.getContextID());
+  }
+  return extensions.get();
+}
+
 #endif /* _OSG_GLEXTENSIONS_H_ */
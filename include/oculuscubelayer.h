@@ -0,0 +1,48 @@
+/*
+ * oculuscubelayer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSCUBELAYER_H_
+#define _OSG_OCULUSCUBELAYER_H_
+
+#include <osg/Quat>
+#include <osg/State>
+#include <osg/TextureCubeMap>
+
+#include <OVR_CAPI_GL.h>
+
+// Compositor cube layer showing a static environment beneath the eye layer, for skyboxes and
+// other backdrops at infinity. The images are uploaded once into a static swap chain, so the
+// compositor keeps the backdrop steady even when the application drops frames. The eye cameras
+// clear to transparent while a cube layer is used, so the scene should not draw a sky of its own.
+class OculusCubeLayer : public osg::Referenced {
+ public:
+  // The six images of the cube map, all square and of the same size, in the face order of OpenGL
+  // cube maps and in tracking space with Y up
+  explicit OculusCubeLayer(osg::TextureCubeMap* cubeMap);
+
+  // Orientation of the cube in tracking space
+  void setOrientation(const osg::Quat& orientation);
+
+  // Uploads the images, called once with the graphics context current
+  void setup(ovrSession session, osg::State& state);
+
+  // Layer to submit with every frame, or null when no images were uploaded
+  const ovrLayerHeader* layer() const {
+    return m_swapChain ? &m_layer.Header : nullptr;
+  }
+
+  void destroy(ovrSession session);
+
+ private:
+  ~OculusCubeLayer() {}
+
+  osg::ref_ptr<osg::TextureCubeMap> m_cubeMap;  // released once uploaded
+  ovrTextureSwapChain m_swapChain = {nullptr};
+  ovrLayerCube m_layer;
+};
+
+#endif /* _OSG_OCULUSCUBELAYER_H_ */
@@ -8,15 +8,72 @@
 #ifndef _OSG_OCULUSDEVICE_H_
 #define _OSG_OCULUSDEVICE_H_
 
+#include <osg/Geometry>
 #include <osg/GraphicsContext>
+#include <osg/RenderInfo>
 #include <osg/State>
+#include <osg/Stats>
+#include <osg/Timer>
 #include <osg/Transform>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include <OVR_CAPI.h>
 
 // Forward declarations
 class OculusTextureBuffer;
 class OculusMirrorTexture;
+class OculusResolutionGovernor;
+class OculusGpuTimer;
+class OculusLateLatch;
+class OculusQuadLayer;
+class OculusCubeLayer;
+class OculusMirrorCapture;
+class OculusPoseStream;
+
+// Compositor statistics of the most recently completed frame, times are in seconds
+struct OculusPerformanceStats {
+  int frameIndex = {0};                     // index of the frame the statistics belong to
+  int appDroppedFrameCount = {0};           // frames dropped by the application since start
+  int compositorDroppedFrameCount = {0};    // frames dropped by the compositor since start
+  float appMotionToPhotonLatency = {0.0f};  // from sampling the pose until displaying the frame
+  bool aswIsAvailable = {false};            // asynchronous spacewarp is available
+  bool aswIsActive = {false};               // frames are extrapolated by asynchronous spacewarp
+  int aswActivatedToggleCount = {0};        // times spacewarp has been activated
+  int aswPresentedFrameCount = {0};         // frames presented by spacewarp
+  int aswFailedFrameCount = {0};            // frames spacewarp failed to produce in time
+  float appGpuElapsedTime = {0.0f};         // GPU time of the application frame
+  float appGpuHeadroom = {0.0f};            // frame budget not used by the application GPU time
+  float compositorCpuElapsedTime = {0.0f};  // CPU time of the compositor
+  float compositorGpuElapsedTime = {0.0f};  // GPU time of the compositor
+  float compositorHeadroom = {0.0f};        // time from compositor GPU end to vertical sync
+  float adaptiveGpuPerformanceScale = {1.0f};  // GPU work scale hitting the frame rate
+};
+
+// Poses and render settings a frame was updated with. They are kept until the frame is submitted,
+// so that drawing and submitting a frame is not affected by the update of the following frames
+// when the viewer draws on a thread of its own.
+struct OculusFrameData {
+  long long frameIndex = {-1};
+  ovrPosef eyeRenderPose[2] = {};
+  ovrEyeRenderDesc eyeRenderDesc[2] = {};
+  double sensorSampleTime = {0.0};
+  float viewportScale = {1.0f};
+  int samples = {0};  // MSAA sample count the eyes are drawn with, 0 keeps the current count
+  ovrTimewarpProjectionDesc timewarpProjectionDesc = {};  // depth mapping of the eye projection
+  bool begunFrame = {false};
+  // Poses sampled again right before the frame was drawn, submitted instead of the culled poses
+  ovrPosef lateRenderPose[2] = {};
+  double lateSensorSampleTime = {0.0};
+  bool lateLatched = {false};
+  // The application is not visible in the headset, the eyes are neither culled nor drawn
+  bool idle = {false};
+  // The mirror texture is blitted to the window and the window buffers are swapped
+  bool mirror = {true};
+};
 
 class OculusDevice : public osg::Referenced {
  public:
@@ -24,6 +81,46 @@ class OculusDevice : public osg::Referenced {
 
   typedef enum TrackingOrigin_ { EYE_LEVEL = 0, FLOOR_LEVEL = 1 } TrackingOrigin;
 
+  // SEPARATE_CAMERAS culls and draws each eye with its own slave camera.
+  // MULTIVIEW culls and draws both eyes with a single camera into a texture array, using
+  // GL_OVR_multiview2. The scene shaders must transform the eye space vertices with the uniform
+  // arrays oculus_ViewMatrix[gl_ViewID_OVR] and oculus_ProjectionMatrix[gl_ViewID_OVR]. A minimal
+  // shader doing so is applied to the camera, for scenes without shaders of their own. Falls back
+  // to SEPARATE_CAMERAS when GL_OVR_multiview2 is not supported.
+  // SHARED_CULL culls both eyes once with a single camera and replays the resulting render graph
+  // for the right eye with only the projection swapped.
+  typedef enum StereoMode_ { SEPARATE_CAMERAS = 0, MULTIVIEW = 1, SHARED_CULL = 2 } StereoMode;
+
+  // TEXTURE_PER_EYE allocates separate swap chains for each eye.
+  // TEXTURE_ARRAY allocates one color and one depth swap chain with one layer per eye.
+  // SIDE_BY_SIDE allocates one double width color and depth swap chain, with the left eye
+  // rendered to the left half and the right eye to the right half.
+  // MULTIVIEW always uses TEXTURE_ARRAY.
+  typedef enum TextureLayout_ {
+    TEXTURE_PER_EYE = 0,
+    TEXTURE_ARRAY = 1,
+    SIDE_BY_SIDE = 2
+  } TextureLayout;
+
+  // Formats of the eye and mirror swap chains. The floating point color formats keep the precision
+  // of linear lighting, DEPTH24_STENCIL8 halves the depth bandwidth of DEPTH32_FLOAT and adds a
+  // stencil buffer. Formats rejected by the runtime fall back to RGBA8_SRGB and DEPTH32_FLOAT.
+  typedef enum ColorFormat_ { RGBA8_SRGB = 0, R11G11B10_FLOAT = 1, RGBA16_FLOAT = 2 } ColorFormat;
+
+  typedef enum DepthFormat_ { DEPTH32_FLOAT = 0, DEPTH24_STENCIL8 = 1, DEPTH16 = 2 } DepthFormat;
+
+  // Contents of the mirror window. MIRROR_BOTH_EYES shows both eye images before lens
+  // distortion, MIRROR_LEFT_EYE and MIRROR_RIGHT_EYE a single one of them, and MIRROR_DISTORTED
+  // the image shown in the headset. MIRROR_DISABLED creates no mirror texture and never swaps the
+  // window buffers.
+  typedef enum MirrorMode_ {
+    MIRROR_BOTH_EYES = 0,
+    MIRROR_LEFT_EYE = 1,
+    MIRROR_RIGHT_EYE = 2,
+    MIRROR_DISTORTED = 3,
+    MIRROR_DISABLED = 4
+  } MirrorMode;
+
   OculusDevice(float nearClip,
                float farClip,
                const float pixelsPerDisplayPixel,
@@ -70,29 +167,294 @@ class OculusDevice : public osg::Referenced {
     return m_blitOnPostDraw;
   }
 
+  // Must be set before the viewer is realized
+  void setStereoMode(StereoMode mode) {
+    m_stereoMode = mode;
+  }
+
+  StereoMode stereoMode() const {
+    return m_stereoMode;
+  }
+
+  // Must be set before the viewer is realized
+  void setTextureLayout(TextureLayout layout) {
+    m_textureLayout = layout;
+  }
+
+  TextureLayout textureLayout() const {
+    return m_textureLayout;
+  }
+
+  // Must be set before the viewer is realized
+  void setTextureFormats(ColorFormat colorFormat, DepthFormat depthFormat) {
+    m_colorFormat = colorFormat;
+    m_depthFormat = depthFormat;
+  }
+
+  ColorFormat colorFormat() const {
+    return m_colorFormat;
+  }
+
+  DepthFormat depthFormat() const {
+    return m_depthFormat;
+  }
+
+  // Must be set before the viewer is realized
+  void setMirrorTextureFormat(ColorFormat format) {
+    m_mirrorFormat = format;
+  }
+
+  ColorFormat mirrorTextureFormat() const {
+    return m_mirrorFormat;
+  }
+
+  // Must be set before the viewer is realized
+  void setMirrorMode(MirrorMode mode) {
+    m_mirrorMode = mode;
+  }
+
+  MirrorMode mirrorMode() const {
+    return m_mirrorMode;
+  }
+
+  // Update the mirror window every frameInterval frames, and at most maxRate times per second
+  // when maxRate is positive. The window buffers are only swapped when the mirror is updated.
+  void setMirrorRefresh(unsigned int frameInterval, float maxRate = 0.0f) {
+    m_mirrorFrameInterval = std::max(frameInterval, 1u);
+    m_mirrorMaxRate = maxRate;
+  }
+
+  // Decides if the mirror window is updated in the frame being updated, called once per frame
+  void updateMirror();
+
+  // Records the mirror texture of every frame which is not idle, independent of the refresh of
+  // the mirror window. Needs a mirror texture, so not with MIRROR_DISABLED.
+  // Must be set before the viewer is realized
+  void setMirrorCapture(OculusMirrorCapture* capture);
+
+  // Skip the pixels hidden by the lenses, by filling them with the nearest depth before each eye
+  // is drawn. Disabled by default.
+  // Must be set before the viewer is realized
+  void setHiddenAreaMask(bool enabled) {
+    m_hiddenAreaMask = enabled;
+  }
+
+  bool hiddenAreaMask() const {
+    return m_hiddenAreaMask;
+  }
+
+  // True if the hidden area mask is enabled and available for the current stereo mode
+  bool usesHiddenAreaMask() const;
+
+  // Scale the rendered part of the eye textures between minScale and 1.0 from the frame timing.
+  // With dynamicSamples the number of MSAA samples is lowered under sustained load.
+  // Must be set before the viewer is realized
+  void setDynamicResolution(bool enabled, float minScale = 0.5f, bool dynamicSamples = false) {
+    m_dynamicResolution = enabled;
+    m_minViewportScale = minScale;
+    m_dynamicSamples = dynamicSamples;
+  }
+
+  bool dynamicResolution() const {
+    return m_dynamicResolution;
+  }
+
+  float viewportScale() const {
+    return m_viewportScale;
+  }
+
+  // Called once per frame, before the eye cameras are updated
+  void updateDynamicResolution();
+
+  // Polls the compositor statistics, called once per frame
+  void updatePerformanceStats(unsigned int frameNumber);
+
+  const OculusPerformanceStats& performanceStats() const {
+    return m_performanceStats;
+  }
+
+  // Sample the eye poses again right before drawing and correct the culled view with them through
+  // the OculusLateLatch uniform block, see oculuslatelatch.h. The compositor is given the late
+  // poses, so all scene shaders should read the block when enabled.
+  // Must be set before the viewer is realized
+  void setLateLatching(bool enabled) {
+    m_lateLatching = enabled;
+  }
+
+  bool lateLatching() const {
+    return m_lateLatching;
+  }
+
+  // Samples the poses of the frame being drawn, if not done for this frame yet, and binds the
+  // view corrections of the eye (or of both eyes for a layered camera). Called by the pre draw
+  // callbacks once the render target is bound.
+  void lateLatch(osg::RenderInfo& renderInfo, int layer);
+
+  // Submits the cube layer beneath the eye layer, the eye cameras then clear to transparent.
+  // Must be set before the viewer is realized
+  void setCubeLayer(OculusCubeLayer* layer);
+
+  OculusCubeLayer* cubeLayer() const {
+    return m_cubeLayer.get();
+  }
+
+  // Submits the quad layer on top of the eye layer, in the order the layers were added.
+  // Must be added before the viewer is realized
+  void addQuadLayer(OculusQuadLayer* layer);
+
+  const std::vector<osg::ref_ptr<OculusQuadLayer>>& quadLayers() const {
+    return m_quadLayers;
+  }
+
+  // Decides which quad layers are drawn in the frame being updated, called once per frame
+  void updateQuadLayers();
+
+  // Skip culling and drawing the eyes and run the frame loop at idleFrameRate while the
+  // application is not visible in the headset or the headset is not worn.
+  // Must be set before the viewer is realized
+  void setIdleWhenNotVisible(bool enabled, float idleFrameRate = 10.0f) {
+    m_idleWhenNotVisible = enabled;
+    m_idleFrameRate = idleFrameRate;
+  }
+
+  bool idleWhenNotVisible() const {
+    return m_idleWhenNotVisible;
+  }
+
+  // Polls the session status and decides if the frame being updated is idle, called once per
+  // frame before the frame is begun. Recenters the tracking origin when requested by the user.
+  void updateSessionStatus();
+
+  // Sleeps for the remainder of the idle frame period, called once per idle frame
+  void idle();
+
+  const ovrSessionStatus& sessionStatus() const {
+    return m_sessionStatus;
+  }
+
+  // The user asked the application to quit from the headset
+  bool shouldQuit() const {
+    return m_sessionStatus.ShouldQuit == ovrTrue;
+  }
+
+  // Clear mask of the eye cameras when the eyes are drawn
+  GLbitfield eyeClearMask() const;
+
+  // Stats receiving the GPU times and the compositor statistics, usually the viewer stats. They
+  // are only published while the stats collect "gpu" and "compositor" respectively.
+  void setStats(osg::Stats* stats) {
+    m_stats = stats;
+  }
+
+  // The GPU timer, or null when the stats are not collecting GPU times
+  OculusGpuTimer* gpuTimer() const;
+
+  // Publishes the GPU times of finished frames, called once per frame after the swap
+  void collectGpuTimes(osg::GraphicsContext* gc);
+
   void resetSensorOrientation() const {
     ovr_RecenterTrackingOrigin(m_session);
   }
 
+  // Starts the update of the next frame and returns its index. Frames are updated, drawn and
+  // submitted in the same order, so the draw and submission of a frame find its data by index.
+  long long advanceFrameIndex();
+
   void updatePose(long long frameIndex);
 
-  osg::Vec3 position(Eye eye) const;
-  osg::Quat orientation(Eye eye) const;
+  // Records the eye poses, the tracking state and the touch controller input of every frame to
+  // the stream, or replays them from the stream instead of querying the runtime. Late latching
+  // is disabled while replaying, since it samples the runtime again.
+  // Must be set before the viewer is realized
+  void setPoseStream(OculusPoseStream* stream);
+
+  // Frame being updated, and frame being drawn. They are the same frame unless the viewer draws
+  // on a thread of its own, in which case the update runs up to two frames ahead.
+  const OculusFrameData& updateFrame() const {
+    return frameData(m_updateFrameIndex);
+  }
+
+  const OculusFrameData& drawFrame() const {
+    return frameData(m_drawFrameIndex);
+  }
+
+  // The functions without a frame argument use the frame being updated
+  osg::Vec3 position(Eye eye) const {
+    return position(eye, updateFrame());
+  }
+  osg::Vec3 position(Eye eye, const OculusFrameData& frame) const;
+  osg::Quat orientation(Eye eye) const {
+    return orientation(eye, updateFrame());
+  }
+  osg::Quat orientation(Eye eye, const OculusFrameData& frame) const;
 
-  osg::Matrixf viewMatrix(Eye eye) const;
-  osg::Matrixf projectionMatrix(Eye eye) const;
+  osg::Matrixf viewMatrix(Eye eye) const {
+    return viewMatrix(eye, updateFrame());
+  }
+  osg::Matrixf viewMatrix(Eye eye, const OculusFrameData& frame) const;
+  osg::Matrixf projectionMatrix(Eye eye) const {
+    return projectionMatrix(eye, updateFrame());
+  }
+  osg::Matrixf projectionMatrix(Eye eye, const OculusFrameData& frame) const;
+  // Region of the eye texture rendered for the eye
+  ovrRecti eyeViewport(Eye eye) const {
+    return eyeViewport(eye, updateFrame());
+  }
+  ovrRecti eyeViewport(Eye eye, const OculusFrameData& frame) const;
+  // Lets the compositor map the submitted depth back to distances, using the clip planes the frame
+  // being updated is rendered with
   void updateTimewarpProjection(Eye eye);
 
+  // View and frustum enclosing both eyes, used when both eyes are culled together
+  osg::Matrixf cullViewMatrix() const {
+    return cullViewMatrix(updateFrame());
+  }
+  osg::Matrixf cullViewMatrix(const OculusFrameData& frame) const;
+  osg::Matrixf cullProjectionMatrix() const {
+    return cullProjectionMatrix(updateFrame());
+  }
+  osg::Matrixf cullProjectionMatrix(const OculusFrameData& frame) const;
+  // View of an eye relative to the cull view
+  osg::Matrixf stereoViewMatrix(Eye eye) const {
+    return stereoViewMatrix(eye, updateFrame());
+  }
+  osg::Matrixf stereoViewMatrix(Eye eye, const OculusFrameData& frame) const;
+  // Projection of an eye relative to the cull view, the stereo view folded into the projection
+  osg::Matrixf stereoProjectionMatrix(Eye eye) const {
+    return stereoProjectionMatrix(eye, updateFrame());
+  }
+  osg::Matrixf stereoProjectionMatrix(Eye eye, const OculusFrameData& frame) const;
+
+  // Switches the eye render targets to the MSAA sample count of the frame being drawn. Called by
+  // the pre draw callback of the first eye, before either eye is drawn.
+  void applyRenderSamples(osg::RenderInfo& renderInfo) const;
+
+  // Clears the depth of the eye viewport of the frame being drawn and fills the area not visible
+  // through the lens with the nearest depth, so that scene fragments covering it are rejected by
+  // the depth test.
+  void drawHiddenAreaMask(osg::RenderInfo& renderInfo, Eye eye) const;
+
   osg::Camera* createRTTCamera(OculusDevice::Eye eye,
                                osg::Transform::ReferenceFrame referenceFrame,
                                const osg::Vec4& clearColor,
-                               osg::GraphicsContext* gc = 0) const;
+                               osg::GraphicsContext* gc = 0);
+  osg::Camera* createStereoRTTCamera(osg::Transform::ReferenceFrame referenceFrame,
+                                     const osg::Vec4& clearColor,
+                                     osg::GraphicsContext* gc = 0);
+
+  // Prepares the camera of a quad layer for drawing into the swap chain of the layer
+  osg::Camera* setupQuadLayerCamera(OculusQuadLayer* layer, osg::GraphicsContext* gc);
+
+  ovrSession session() const {
+    return m_session;
+  }
 
   bool waitToBeginFrame(long long frameIndex = 0);
   bool beginFrame(long long frameIndex = 0);
 
   bool submitFrame(long long frameIndex = 0);
   void blitMirrorTexture(osg::GraphicsContext* gc) const;
+  void captureMirrorTexture(osg::GraphicsContext* gc) const;
 
   void setPerfHudMode(int mode);
 
@@ -122,12 +484,33 @@ class OculusDevice : public osg::Referenced {
 
   void printHMDDebugInfo();
 
+  // Frames in flight, enough for the update to run two frames ahead of the draw
+  static const int FRAME_DATA_COUNT = 4;
+
+  const OculusFrameData& frameData(long long frameIndex) const {
+    return m_frameData[frameIndex & (FRAME_DATA_COUNT - 1)];
+  }
+
+  OculusFrameData& frameData(long long frameIndex) {
+    return m_frameData[frameIndex & (FRAME_DATA_COUNT - 1)];
+  }
+
+  osg::Matrixf viewMatrix(const osg::Vec3& eyePosition, const osg::Quat& eyeOrientation) const;
+
   void getEyeRenderDesc();
 
+  void setupFrameData();
+
   void setTrackingOrigin();
 
   void setupLayers();
 
+  void setupHiddenAreaMeshes();
+
+  osg::Vec4 eyeClearColor(const osg::Vec4& clearColor) const;
+
+  bool replayingPoses() const;
+
   void trySetProcessAsHighPriority() const;
 
   ovrSession m_session = {nullptr};
@@ -141,15 +524,35 @@ class OculusDevice : public osg::Referenced {
 
   osg::ref_ptr<OculusTextureBuffer> m_textureBuffer[2] = {nullptr, nullptr};
   osg::ref_ptr<OculusMirrorTexture> m_mirrorTexture = {nullptr};
+  osg::ref_ptr<OculusMirrorCapture> m_mirrorCapture = {nullptr};
+  osg::ref_ptr<OculusPoseStream> m_poseStream = {nullptr};
+  osg::ref_ptr<OculusResolutionGovernor> m_resolutionGovernor = {nullptr};
+  osg::ref_ptr<OculusGpuTimer> m_gpuTimer = {nullptr};
+  osg::ref_ptr<OculusLateLatch> m_lateLatch = {nullptr};
+  std::vector<osg::ref_ptr<OculusQuadLayer>> m_quadLayers;
+  osg::ref_ptr<OculusCubeLayer> m_cubeLayer = {nullptr};
+  osg::observer_ptr<osg::Stats> m_stats = {nullptr};
+
+  osg::ref_ptr<osg::Geometry> m_hiddenAreaMesh[2] = {nullptr, nullptr};
+  osg::ref_ptr<osg::StateSet> m_hiddenAreaStateSet = {nullptr};
+  osg::ref_ptr<osg::RefMatrix> m_identityMatrix = {new osg::RefMatrix()};
 
   unsigned int m_mirrorTextureWidth;
 
   ovrEyeRenderDesc m_eyeRenderDesc[2];
   ovrVector2f m_UVScaleOffset[2][2];
-  double m_sensorSampleTime;
-  ovrPosef m_eyeRenderPose[2];
+  OculusFrameData m_frameData[FRAME_DATA_COUNT];
+  // Frame being updated and frame being drawn, the draw thread may still be a frame behind
+  std::atomic<long long> m_updateFrameIndex = {-1};
+  std::atomic<long long> m_drawFrameIndex = {0};
+  // Guards the late latched poses, written by the draw thread while the update copies the frame
+  std::mutex m_lateLatchMutex;
   ovrLayerEyeFovDepth m_layerEyeFovDepth;
-  ovrTimewarpProjectionDesc m_posTimewarpProjectionDesc = {};
+  ovrPerfStats m_perfStats = {};
+  OculusPerformanceStats m_performanceStats;
+  ovrSessionStatus m_sessionStatus = {};
+  std::atomic<bool> m_endFrameNotVisible = {false};  // set by the submission of the last frame
+  osg::Timer_t m_idleTick = {0};
 
   osg::Vec3 m_position{};
   osg::Quat m_orientation{};
@@ -157,9 +560,25 @@ class OculusDevice : public osg::Referenced {
   float m_nearClip;
   float m_farClip;
   int m_samples = {0};
-  bool m_begunFrame = {false};
   bool m_blitOnPostDraw = {false};
   TrackingOrigin m_origin;
+  StereoMode m_stereoMode = {SEPARATE_CAMERAS};
+  TextureLayout m_textureLayout = {TEXTURE_PER_EYE};
+  ColorFormat m_colorFormat = {RGBA8_SRGB};
+  DepthFormat m_depthFormat = {DEPTH32_FLOAT};
+  ColorFormat m_mirrorFormat = {RGBA8_SRGB};
+  MirrorMode m_mirrorMode = {MIRROR_BOTH_EYES};
+  unsigned int m_mirrorFrameInterval = {1};
+  float m_mirrorMaxRate = {0.0f};
+  osg::Timer_t m_mirrorTick = {0};
+  bool m_hiddenAreaMask = {false};
+  bool m_lateLatching = {false};
+  bool m_idleWhenNotVisible = {false};
+  float m_idleFrameRate = {10.0f};
+  bool m_dynamicResolution = {false};
+  bool m_dynamicSamples = {false};
+  float m_minViewportScale = {0.5f};
+  float m_viewportScale = {1.0f};
 };
 
 #endif /* _OSG_OCULUSDEVICE_H_ */
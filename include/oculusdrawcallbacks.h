@@ -13,6 +13,7 @@
 // Forward declaration
 class OculusTextureBuffer;
 class OculusDevice;
+class OculusQuadLayer;
 
 class OculusInitialDrawCallback : public osg::Camera::DrawCallback {
  public:
@@ -21,15 +22,23 @@ class OculusInitialDrawCallback : public osg::Camera::DrawCallback {
 
 class OculusPreDrawCallback : public osg::Camera::DrawCallback {
  public:
-  OculusPreDrawCallback(osg::Camera* camera, OculusTextureBuffer* textureBuffer) :
+  // Layer -1 renders to all layers of a texture array at once
+  OculusPreDrawCallback(osg::Camera* camera,
+                        OculusTextureBuffer* textureBuffer,
+                        OculusDevice* device,
+                        int layer = -1) :
       m_camera(camera),
-      m_textureBuffer(textureBuffer) {}
+      m_textureBuffer(textureBuffer),
+      m_device(device),
+      m_layer(layer) {}
 
   void operator()(osg::RenderInfo& renderInfo) const override;
 
  private:
   osg::observer_ptr<osg::Camera> m_camera;
   osg::observer_ptr<OculusTextureBuffer> m_textureBuffer;
+  OculusDevice* m_device;
+  int m_layer;
 };
 
 class OculusPostDrawCallback : public osg::Camera::DrawCallback {
@@ -37,6 +46,7 @@ class OculusPostDrawCallback : public osg::Camera::DrawCallback {
   OculusPostDrawCallback(osg::Camera* camera,
                          OculusTextureBuffer* textureBuffer,
                          const OculusDevice* device,
+                         int layer = -1,
                          bool blit = false);
 
   void operator()(osg::RenderInfo& renderInfo) const override;
@@ -45,7 +55,69 @@ class OculusPostDrawCallback : public osg::Camera::DrawCallback {
   osg::observer_ptr<osg::Camera> m_camera;
   osg::observer_ptr<OculusTextureBuffer> m_textureBuffer;
   const OculusDevice* m_device;
+  int m_layer;
   bool m_blit;
 };
 
+// Draw callbacks for a camera culling both eyes at once. The left eye is drawn by the camera and
+// the render graph of that draw is replayed for the right eye with the projection swapped.
+class OculusStereoPreDrawCallback : public osg::Camera::DrawCallback {
+ public:
+  OculusStereoPreDrawCallback(osg::Camera* camera,
+                              OculusTextureBuffer* textureBuffer,
+                              OculusDevice* device);
+
+  void operator()(osg::RenderInfo& renderInfo) const override;
+
+ private:
+  osg::observer_ptr<osg::Camera> m_camera;
+  osg::observer_ptr<OculusTextureBuffer> m_textureBuffer;
+  OculusDevice* m_device;
+};
+
+class OculusStereoPostDrawCallback : public osg::Camera::DrawCallback {
+ public:
+  OculusStereoPostDrawCallback(osg::Camera* camera,
+                               OculusTextureBuffer* leftTextureBuffer,
+                               OculusTextureBuffer* rightTextureBuffer,
+                               OculusDevice* device,
+                               bool blit = false);
+
+  void operator()(osg::RenderInfo& renderInfo) const override;
+
+ private:
+  osg::observer_ptr<osg::Camera> m_camera;
+  osg::observer_ptr<OculusTextureBuffer> m_leftTextureBuffer;
+  osg::observer_ptr<OculusTextureBuffer> m_rightTextureBuffer;
+  OculusDevice* m_device;
+  bool m_blit;
+};
+
+// Draw callbacks for the camera of a quad layer, which only draw in frames the layer is updated
+class OculusQuadLayerPreDrawCallback : public osg::Camera::DrawCallback {
+ public:
+  OculusQuadLayerPreDrawCallback(OculusQuadLayer* layer, const OculusDevice* device) :
+      m_layer(layer),
+      m_device(device) {}
+
+  void operator()(osg::RenderInfo& renderInfo) const override;
+
+ private:
+  osg::observer_ptr<OculusQuadLayer> m_layer;
+  const OculusDevice* m_device;
+};
+
+class OculusQuadLayerPostDrawCallback : public osg::Camera::DrawCallback {
+ public:
+  OculusQuadLayerPostDrawCallback(OculusQuadLayer* layer, const OculusDevice* device) :
+      m_layer(layer),
+      m_device(device) {}
+
+  void operator()(osg::RenderInfo& renderInfo) const override;
+
+ private:
+  osg::observer_ptr<OculusQuadLayer> m_layer;
+  const OculusDevice* m_device;
+};
+
 #endif /* _OSG_OCULUSDRAWCALLBACKS_H_ */
@@ -0,0 +1,67 @@
+/*
+ * oculusgputimer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSGPUTIMER_H_
+#define _OSG_OCULUSGPUTIMER_H_
+
+#include <osg/State>
+#include <osg/Stats>
+
+// Measures the GPU time of the stages of a frame with timestamp queries. The queries of the last
+// few frames are kept in a ring and only read once the GPU has made them available, so measuring
+// never stalls the pipeline.
+class OculusGpuTimer : public osg::Referenced {
+ public:
+  typedef enum Stage_ {
+    LEFT_EYE = 0,
+    RIGHT_EYE = 1,
+    BOTH_EYES = 2,
+    MSAA_RESOLVE = 3,
+    MIRROR_BLIT = 4,
+    STAGE_COUNT = 5
+  } Stage;
+
+  explicit OculusGpuTimer(const osg::State& state);
+  void destroy(const osg::State& state);
+
+  void begin(const osg::State& state, Stage stage);
+  void end(const osg::State& state, Stage stage);
+
+  // Closes the current frame and publishes the frames finished by the GPU to stats
+  void endFrame(const osg::State& state, osg::Stats* stats);
+
+  // Name of the stats attribute holding the time of the stage, in seconds
+  static const char* attributeName(Stage stage);
+
+  // Last measured time of the stage in seconds
+  double lastTime(Stage stage) const {
+    return m_lastTime[stage];
+  }
+
+ private:
+  ~OculusGpuTimer() {}
+
+  enum { FRAME_COUNT = 4, MAX_SPANS = 2 };
+
+  struct Frame {
+    // Begin and end timestamp queries of each measured span
+    GLuint queries[STAGE_COUNT][MAX_SPANS][2];
+    int spanCount[STAGE_COUNT];
+    GLuint lastQuery;
+    unsigned int frameNumber;
+    bool pending;
+  };
+
+  bool readFrame(const osg::State& state, Frame& frame, osg::Stats* stats);
+
+  Frame m_frames[FRAME_COUNT];
+  int m_currentFrame = {0};
+  bool m_open[STAGE_COUNT] = {};
+  double m_lastTime[STAGE_COUNT] = {};
+};
+
+#endif /* _OSG_OCULUSGPUTIMER_H_ */
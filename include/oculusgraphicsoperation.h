@@ -12,6 +12,7 @@
 
 // Forward declaration
 class OculusDevice;
+class OculusViewer;
 
 class OculusRealizeOperation : public osg::GraphicsOperation {
  public:
@@ -23,9 +24,15 @@ class OculusRealizeOperation : public osg::GraphicsOperation {
     return m_realized;
   }
 
+  // Viewer configured once the device is initialized, set by the viewer itself
+  void setViewer(OculusViewer* viewer) {
+    m_viewer = viewer;
+  }
+
  private:
   OpenThreads::Mutex _mutex;
   osg::observer_ptr<OculusDevice> m_device;
+  osg::observer_ptr<OculusViewer> m_viewer;
   bool m_realized = {false};
 };
 
@@ -0,0 +1,53 @@
+/*
+ * oculuslatelatch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSLATELATCH_H_
+#define _OSG_OCULUSLATELATCH_H_
+
+#include <osg/Matrixf>
+#include <osg/State>
+
+// Persistently mapped uniform buffer with the eye pose corrections sampled right before drawing.
+// The scene shaders opt in by declaring the block
+//
+//   layout(std140, binding = 3) uniform OculusLateLatch {
+//     mat4 oculus_LateLatchMatrix[2];
+//   };
+//
+// and multiplying the eye space position with it before the projection:
+//
+//   gl_Position = gl_ProjectionMatrix * oculus_LateLatchMatrix[0] * gl_ModelViewMatrix * gl_Vertex;
+//
+// A camera drawing a single eye stores its correction in both elements, a layered camera stores
+// the correction of each eye in the element of its layer.
+class OculusLateLatch : public osg::Referenced {
+ public:
+  enum { UNIFORM_BLOCK_BINDING = 3 };
+
+  explicit OculusLateLatch(const osg::State& state);
+  void destroy(const osg::State& state);
+
+  // Writes the corrections of a camera of the frame and binds them to the uniform block binding.
+  // Slot 0 and 1 give each eye camera of the frame a region of its own.
+  void apply(const osg::State& state,
+             long long frameIndex,
+             int slot,
+             const osg::Matrixf& left,
+             const osg::Matrixf& right);
+
+ private:
+  ~OculusLateLatch() {}
+
+  // Frames whose corrections may still be read by the GPU, and cameras per frame
+  enum { FRAME_COUNT = 3, SLOT_COUNT = 2 };
+
+  GLuint m_buffer = {0};
+  GLsizeiptr m_stride = {0};
+  unsigned char* m_data = {nullptr};
+};
+
+#endif /* _OSG_OCULUSLATELATCH_H_ */
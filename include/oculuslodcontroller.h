@@ -0,0 +1,44 @@
+/*
+ * oculuslodcontroller.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSLODCONTROLLER_H_
+#define _OSG_OCULUSLODCONTROLLER_H_
+
+#include <osg/Referenced>
+
+struct OculusPerformanceStats;
+
+// Controller of the level of detail of the eye cameras from the frame timing. The detail is
+// lowered in steps while frames run over budget and raised again after a sustained period with
+// headroom, with a band in between where nothing changes, so that the LOD does not oscillate.
+// The LOD scale ranges from 1.0 to maxLODScale, and the small feature culling pixel size from
+// minPixelSize to maxPixelSize.
+class OculusLODController : public osg::Referenced {
+ public:
+  OculusLODController(float maxLODScale, float minPixelSize, float maxPixelSize);
+
+  // Update from the compositor statistics, frameBudget is the frame time in seconds
+  void update(const OculusPerformanceStats& stats, double frameBudget);
+
+  float lodScale() const;
+
+  float smallFeatureCullingPixelSize() const;
+
+ private:
+  ~OculusLODController() {}
+
+  const float m_maxLODScale;
+  const float m_minPixelSize;
+  const float m_maxPixelSize;
+  int m_level = {0};              // steps of reduced detail, 0 is full detail
+  int m_lastFrameIndex = {0};     // compositor frame of the latest statistics used
+  int m_droppedFrameCount = {0};  // frames dropped by the application at the latest update
+  int m_overloadedFrames = {0};   // consecutive frames over budget
+  int m_underloadedFrames = {0};  // consecutive frames with headroom
+};
+
+#endif /* _OSG_OCULUSLODCONTROLLER_H_ */
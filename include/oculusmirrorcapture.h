@@ -0,0 +1,93 @@
+/*
+ * oculusmirrorcapture.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSMIRRORCAPTURE_H_
+#define _OSG_OCULUSMIRRORCAPTURE_H_
+
+#include <osg/GLExtensions>
+#include <osg/State>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the mirror texture to a file without stalling the draw thread. Every frame is read
+// back into a ring of persistently mapped pixel buffers, and a buffer is handed to a writer
+// thread once its fence shows the GPU has filled it. Frames are dropped, never waited for, when
+// all buffers are still in use.
+class OculusMirrorCapture : public osg::Referenced {
+ public:
+  // RAW_RGB writes packed 8 bit RGB frames without any header, Y4M writes a YUV4MPEG2 stream
+  // with full resolution chroma which most video tools read directly.
+  typedef enum Format_ { RAW_RGB = 0, Y4M = 1 } Format;
+
+  OculusMirrorCapture(const std::string& fileName, Format format = Y4M, int frameRate = 90);
+
+  // Starts the readback of a frame from the framebuffer and hands finished readbacks to the
+  // writer thread. Called by the draw thread once per frame.
+  void capture(const osg::State& state, GLuint readFramebuffer, int width, int height);
+
+  // Writes the frames still being read back and stops the writer thread
+  void destroy(const osg::State& state);
+
+  unsigned int capturedFrames() const {
+    return m_capturedFrames;
+  }
+
+  unsigned int droppedFrames() const {
+    return m_droppedFrames;
+  }
+
+ private:
+  ~OculusMirrorCapture();
+  OculusMirrorCapture(const OculusMirrorCapture&) = delete;
+  OculusMirrorCapture& operator=(const OculusMirrorCapture&) = delete;
+
+  void setup(const osg::State& state, int width, int height);
+  void retire(const osg::State& state, GLuint64 timeout);
+  void run();
+  void writeFrame(const unsigned char* pixels);
+  void stop();
+
+  // Frames in flight between the GPU and the file
+  enum { BUFFER_COUNT = 4 };
+
+  typedef enum SlotState_ { FREE = 0, READING = 1, WRITING = 2 } SlotState;
+
+  std::string m_fileName;
+  Format m_format;
+  int m_frameRate;
+  int m_width = {0};
+  int m_height = {0};
+  bool m_failed = {false};
+
+  GLuint m_buffer = {0};
+  GLsizeiptr m_frameSize = {0};
+  unsigned char* m_data = {nullptr};
+  GLsync m_fences[BUFFER_COUNT] = {};
+  std::atomic<int> m_slotState[BUFFER_COUNT] = {};
+  int m_nextSlot = {0};    // next slot to read back into
+  int m_retireSlot = {0};  // oldest slot being read back
+
+  std::ofstream m_file;
+  std::vector<unsigned char> m_row;  // converted row, only used by the writer thread
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<int> m_queue;  // slots ready to be written, oldest first
+  bool m_stop = {false};
+
+  std::atomic<unsigned int> m_capturedFrames = {0};
+  std::atomic<unsigned int> m_droppedFrames = {0};
+};
+
+#endif /* _OSG_OCULUSMIRRORCAPTURE_H_ */
@@ -13,9 +13,16 @@
 
 #include <OVR_CAPI_GL.h>
 
+class OculusMirrorCapture;
+
 class OculusMirrorTexture : public osg::Referenced {
  public:
-  OculusMirrorTexture(ovrSession& session, osg::ref_ptr<osg::State> state, int width, int height);
+  OculusMirrorTexture(ovrSession& session,
+                      osg::ref_ptr<osg::State> state,
+                      int width,
+                      int height,
+                      ovrTextureFormat format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB,
+                      unsigned int mirrorOptions = ovrMirrorOption_Default);
   void destroy(osg::GraphicsContext* gc = 0);
   GLint width() const {
     return m_width;
@@ -24,6 +31,10 @@ class OculusMirrorTexture : public osg::Referenced {
     return m_height;
   }
   void blitTexture(osg::GraphicsContext* gc) const;
+  // Records the mirror texture, see oculusmirrorcapture.h
+  void setCapture(OculusMirrorCapture* capture);
+  // Starts the readback of the current mirror image, when capturing
+  void capture(osg::GraphicsContext* gc) const;
 
  private:
   ~OculusMirrorTexture() {}
@@ -32,6 +43,7 @@ class OculusMirrorTexture : public osg::Referenced {
   GLint m_width;
   GLint m_height;
   GLuint m_mirrorFBO;
+  osg::ref_ptr<OculusMirrorCapture> m_capture;
 };
 
 #endif /* _OSG_OCULUSMIRRORTEXTURE_H_ */
@@ -0,0 +1,74 @@
+/*
+ * oculusposestream.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSPOSESTREAM_H_
+#define _OSG_OCULUSPOSESTREAM_H_
+
+#include <osg/Referenced>
+
+#include <fstream>
+#include <string>
+
+#include <OVR_CAPI.h>
+
+// Tracking and input state of one frame, as stored in a pose stream
+struct OculusPoseSample {
+  ovrPosef eyeRenderPose[2];
+  ovrPoseStatef headPose;
+  ovrPoseStatef handPoses[2];
+  ovrInputState controllerState;
+};
+
+// Binary file of the tracking and input state of every frame. A recorded stream replayed into the
+// device gives every run the same head motion and controller input, for comparing the
+// performance of scene changes. The file is the samples stored back to back after a small
+// header, and is memory mapped when replayed. Streams are only read by builds with the same
+// LibOVR structure layout as the build which recorded them.
+class OculusPoseStream : public osg::Referenced {
+ public:
+  typedef enum Mode_ { RECORD = 0, REPLAY = 1 } Mode;
+
+  OculusPoseStream(const std::string& fileName, Mode mode);
+
+  Mode mode() const {
+    return m_mode;
+  }
+
+  // False if the file could not be opened, or is not a pose stream of this build
+  bool valid() const {
+    return m_mode == RECORD ? m_file.good() : m_samples != nullptr;
+  }
+
+  unsigned int sampleCount() const {
+    return m_sampleCount;
+  }
+
+  // Appends the sample of the next frame when recording
+  void write(const OculusPoseSample& sample);
+
+  // Returns the sample of the next frame when replaying, starting over after the last one
+  const OculusPoseSample& read();
+
+ private:
+  ~OculusPoseStream();
+  OculusPoseStream(const OculusPoseStream&) = delete;
+  OculusPoseStream& operator=(const OculusPoseStream&) = delete;
+
+  void map(const std::string& fileName);
+  void unmap();
+
+  Mode m_mode;
+  std::ofstream m_file;  // only used when recording
+
+  const unsigned char* m_mapping = {nullptr};  // whole file, only used when replaying
+  size_t m_mappingSize = {0};
+  const OculusPoseSample* m_samples = {nullptr};
+  unsigned int m_sampleCount = {0};
+  unsigned int m_nextSample = {0};
+};
+
+#endif /* _OSG_OCULUSPOSESTREAM_H_ */
@@ -0,0 +1,127 @@
+/*
+ * oculusquadlayer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSQUADLAYER_H_
+#define _OSG_OCULUSQUADLAYER_H_
+
+#include <osg/Camera>
+#include <osg/Quat>
+#include <osg/Vec3>
+
+#include <atomic>
+#include <vector>
+
+#include <OVR_CAPI_GL.h>
+
+// Compositor quad layer showing a subgraph rendered into a small swap chain of its own, for HUD
+// panels and other overlays which change less often than the scene. The compositor shows the
+// last rendered image every frame, so the subgraph is only drawn when the layer is updated.
+class OculusQuadLayer : public osg::Referenced {
+ public:
+  // The subgraph is drawn with a 2D projection covering width x height pixels
+  OculusQuadLayer(osg::Node* subgraph, int width, int height);
+
+  // Frames between updates of the layer, 0 only updates the layer when requested
+  void setUpdateInterval(unsigned int frames) {
+    m_updateInterval = frames;
+  }
+
+  unsigned int updateInterval() const {
+    return m_updateInterval;
+  }
+
+  // Draws the layer again in the next frame
+  void requestUpdate() {
+    m_updateRequested = true;
+  }
+
+  // Center and orientation of the quad in metres, relative to the tracking origin or relative to
+  // the head when head locked
+  void setPose(const osg::Vec3& position, const osg::Quat& orientation) {
+    m_position = position;
+    m_orientation = orientation;
+  }
+
+  // Size of the quad in metres
+  void setSize(float width, float height) {
+    m_width = width;
+    m_height = height;
+  }
+
+  void setHeadLocked(bool headLocked) {
+    m_headLocked = headLocked;
+  }
+
+  bool headLocked() const {
+    return m_headLocked;
+  }
+
+  void setVisible(bool visible) {
+    m_visible = visible;
+  }
+
+  bool visible() const {
+    return m_visible;
+  }
+
+  // Camera drawing the subgraph, e.g. to change its projection or clear color
+  osg::Camera* camera() const {
+    return m_camera.get();
+  }
+
+  // Decides if the layer is drawn in the frame being updated and stores its placement for the
+  // submission of that frame. Idle frames draw nothing and keep requested updates pending.
+  bool update(long long frameIndex, bool idle = false);
+
+  // True if the layer is drawn in the frame, its swap chain is then committed with the frame
+  bool drawn(long long frameIndex) const {
+    return m_frameDrawn[frameIndex & (FRAME_COUNT - 1)];
+  }
+
+  // Layer to submit with the frame, or null when it is hidden or has never been drawn
+  const ovrLayerHeader* layer(long long frameIndex) const;
+
+  void onPreRender(osg::RenderInfo& renderInfo, ovrSession session);
+  void onPostRender(osg::RenderInfo& renderInfo);
+  void commit(ovrSession session);
+  void destroy(ovrSession session, osg::GraphicsContext* gc);
+
+ private:
+  ~OculusQuadLayer() {}
+
+  void setup(const osg::State& state, ovrSession session);
+
+  // Frames in flight, the same as kept by the device
+  enum { FRAME_COUNT = 4 };
+
+  osg::ref_ptr<osg::Camera> m_camera;
+  int m_textureWidth;
+  int m_textureHeight;
+
+  ovrTextureSwapChain m_swapChain = {nullptr};
+  std::vector<GLuint> m_framebuffers;  // one per swap chain image
+  GLuint m_depthBuffer = {0};
+  int m_imageIndex = {0};
+  bool m_hasContent = {false};
+  bool m_failed = {false};  // the swap chain could not be created, setup is not retried
+
+  ovrLayerQuad m_frameLayers[FRAME_COUNT];
+  bool m_frameVisible[FRAME_COUNT] = {};
+  bool m_frameDrawn[FRAME_COUNT] = {};
+
+  std::atomic<bool> m_updateRequested = {true};
+  long long m_lastUpdateFrame = {0};
+  unsigned int m_updateInterval = {0};
+  osg::Vec3 m_position = {0.0f, 0.0f, -1.0f};
+  osg::Quat m_orientation;
+  float m_width = {0.5f};
+  float m_height = {0.5f};
+  bool m_headLocked = {false};
+  bool m_visible = {true};
+};
+
+#endif /* _OSG_OCULUSQUADLAYER_H_ */
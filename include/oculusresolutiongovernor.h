@@ -0,0 +1,55 @@
+/*
+ * oculusresolutiongovernor.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSRESOLUTIONGOVERNOR_H_
+#define _OSG_OCULUSRESOLUTIONGOVERNOR_H_
+
+#include <osg/Referenced>
+
+#include <OVR_CAPI.h>
+
+// Closed loop controller of the part of the eye textures that is rendered each frame.
+// The scale is applied to the width and height of the eye viewports, so the textures are never
+// reallocated. Under sustained load the number of MSAA samples can be lowered as well.
+class OculusResolutionGovernor : public osg::Referenced {
+ public:
+  OculusResolutionGovernor(float minScale, float maxScale, int maxSamples);
+
+  // Update from the compositor statistics, frameBudget is the frame time in seconds
+  void update(const ovrPerfStats& stats, double frameBudget);
+
+  float viewportScale() const {
+    return m_scale;
+  }
+
+  int samples() const {
+    return m_samples;
+  }
+
+  void setDynamicSamples(bool enabled) {
+    m_dynamicSamples = enabled;
+  }
+
+  bool dynamicSamples() const {
+    return m_dynamicSamples;
+  }
+
+ private:
+  ~OculusResolutionGovernor() {}
+  void updateSamples(double performanceScale);
+
+  const float m_minScale;
+  const float m_maxScale;
+  const int m_maxSamples;
+  float m_scale = {1.0f};
+  int m_samples = {0};
+  bool m_dynamicSamples = {false};
+  int m_overloadedFrames = {0};  // consecutive frames over budget at the lowest scale
+  int m_idleFrames = {0};        // consecutive frames with headroom at the highest scale
+};
+
+#endif /* _OSG_OCULUSRESOLUTIONGOVERNOR_H_ */
@@ -11,18 +11,32 @@
 #ifndef _OSG_OCULUSTEXTURE_H_
 #define _OSG_OCULUSTEXTURE_H_
 
-#include <osg/Texture2D>
+#include <osg/GraphicsContext>
+#include <osg/RenderInfo>
+#include <osg/State>
+#include <osg/Vec2i>
+#include <osg/Vec4i>
 
-#include <osg/FrameBufferObject>
+#include <vector>
 
 #include <OVR_CAPI_GL.h>
 
+// Eye render target backed by swap chains. A complete framebuffer is built for every swap chain
+// image when the buffer is created, so drawing a frame only binds the framebuffer of the current
+// image. The render target is always bound by the draw callbacks, never by the OSG camera setup.
 class OculusTextureBuffer : public osg::Referenced {
  public:
+  // Layer argument used when all layers of a texture array are rendered at once
+  enum { ALL_LAYERS = -1 };
+
   OculusTextureBuffer(const ovrSession& session,
                       osg::State* state,
                       const ovrSizei& size,
-                      int msaaSamples);
+                      int msaaSamples,
+                      int arraySize = 1,
+                      bool sideBySide = false,
+                      ovrTextureFormat colorFormat = OVR_FORMAT_R8G8B8A8_UNORM_SRGB,
+                      ovrTextureFormat depthFormat = OVR_FORMAT_D32_FLOAT);
   void destroy(osg::GraphicsContext* gc);
   int textureWidth() const {
     return m_textureSize.x();
@@ -33,37 +47,89 @@ class OculusTextureBuffer : public osg::Referenced {
   int samples() const {
     return m_samples;
   }
+  int arraySize() const {
+    return m_arraySize;
+  }
+  bool multiview() const {
+    return m_multiview;
+  }
+  bool sideBySide() const {
+    return m_sideBySide;
+  }
   ovrTextureSwapChain colorTextureSwapChain() const {
     return m_colorTextureSwapChain;
   }
   ovrTextureSwapChain depthTextureSwapChain() const {
     return m_depthTextureSwapChain;
   }
-  osg::Texture2D* colorBuffer() const {
-    return m_colorBuffer.get();
+  // Formats of the swap chains, which differ from the requested ones after a fallback
+  ovrTextureFormat colorFormat() const {
+    return m_colorFormat;
+  }
+  ovrTextureFormat depthFormat() const {
+    return m_depthFormat;
   }
-  osg::Texture2D* depthBuffer() const {
-    return m_depthBuffer.get();
+  bool hasStencil() const {
+    return m_depthFormat == OVR_FORMAT_D24_UNORM_S8_UINT;
   }
-  void onPreRender(osg::RenderInfo& renderInfo);
-  void onPostRender(osg::RenderInfo& renderInfo);
+  // Number of MSAA samples used from now on, when rendering with MSAA. Only the multisample render
+  // target is reallocated, so it must not be called between the eyes of a frame.
+  void setRenderSamples(const osg::State& state, int samples);
+  void onPreRender(osg::RenderInfo& renderInfo, int layer = ALL_LAYERS);
+  void onPostRender(osg::RenderInfo& renderInfo, int layer = ALL_LAYERS);
+  void commit();
 
  private:
   const ovrSession m_session;
   ovrTextureSwapChain m_colorTextureSwapChain = {nullptr};
   ovrTextureSwapChain m_depthTextureSwapChain = {nullptr};
-  osg::ref_ptr<osg::Texture2D> m_colorBuffer = {nullptr};
-  osg::ref_ptr<osg::Texture2D> m_depthBuffer = {nullptr};
   osg::Vec2i m_textureSize;
+  ovrTextureFormat m_colorFormat;
+  ovrTextureFormat m_depthFormat;
+
+  void setup();
+  void createFramebuffers(const osg::State& state);
+  void createMSAATextures(const osg::State& state);
+  void deleteMSAATextures(const osg::State& state);
+  void storeTextureIds();
+  void invalidate(const osg::State& state, GLenum target, GLuint fbo) const;
+  void blit(const osg::State& state, GLuint readFbo, GLuint drawFbo) const;
+  void attachView(const osg::State& state,
+                  GLenum attachment,
+                  GLuint texId,
+                  GLenum target,
+                  int view) const;
+
+  GLenum depthAttachment() const;
+
+  // Framebuffers per image: one binding all layers, followed by one per layer of texture arrays
+  int viewCount() const {
+    return m_arraySize > 1 ? m_arraySize + 1 : 1;
+  }
+  int viewIndex(int layer) const {
+    return m_arraySize > 1 && layer != ALL_LAYERS ? layer + 1 : 0;
+  }
+  GLuint imageFramebuffer(int view) const {
+    return m_imageFBOs.empty() ? 0 : m_imageFBOs[m_imageIndex * viewCount() + view];
+  }
 
-  void setup(osg::State* state);
-  void setupMSAA(osg::State* state);
+  std::vector<GLuint> m_colorTextureIds;  // texture ids of the swap chain images
+  std::vector<GLuint> m_depthTextureIds;
+  // Current image of both swap chains. They are created alike and committed together, so their
+  // current indices are always the same. Only advanced by commit().
+  int m_imageIndex = {0};
 
-  GLuint m_Oculus_FBO = {0};     // MSAA FBO is copied to this FBO after render.
-  GLuint m_MSAA_FBO = {0};       // framebuffer for MSAA texture
-  GLuint m_MSAA_ColorTex = {0};  // color texture for MSAA
-  GLuint m_MSAA_DepthTex = {0};  // depth texture for MSAA
-  int m_samples = {1};           // sample width for MSAA
+  std::vector<GLuint> m_imageFBOs;  // framebuffers of the swap chain images, per view
+  std::vector<GLuint> m_MSAA_FBOs;  // framebuffers of the MSAA textures, per view
+  GLuint m_MSAA_ColorTex = {0};     // color texture for MSAA texture arrays
+  GLuint m_MSAA_DepthTex = {0};     // depth texture for MSAA texture arrays
+  GLuint m_MSAA_ColorRB = {0};      // color renderbuffer for MSAA, never sampled
+  GLuint m_MSAA_DepthRB = {0};      // depth renderbuffer for MSAA, never sampled
+  osg::Vec4i m_drawnRegion;         // x, y, width and height drawn since the last resolve
+  int m_samples = {1};              // sample width for MSAA
+  int m_arraySize = {1};       // number of layers, one per eye when rendering both eyes at once
+  bool m_multiview = {false};  // use GL_OVR_multiview2 instead of geometry shader layers
+  bool m_sideBySide = {false};  // both eyes share the texture, left eye in the left half
 };
 
 #endif /* _OSG_OCULUSTEXTURE_H_ */
@@ -0,0 +1,63 @@
+/*
+ * oculustrace.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OCULUSTRACE_H_
+#define _OSG_OCULUSTRACE_H_
+
+#include <osg/Timer>
+
+#include <atomic>
+#include <string>
+
+// Records spans of the frame loop into a preallocated ring buffer, which can be written as a
+// Chrome trace (JSON) file and opened in chrome://tracing or Perfetto. Recording is lock free, and
+// when tracing is disabled a span costs a single atomic load.
+class OculusTrace {
+ public:
+  // Allocates room for capacity spans and starts recording. Only the latest capacity spans are
+  // kept, older spans are overwritten.
+  static void enable(unsigned int capacity = 1 << 16);
+  static bool enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  // Frame index is the frame the span works on, which differs between the update and draw threads
+  static void record(const char* name, long long frameIndex, osg::Timer_t start, osg::Timer_t end);
+
+  // File written by write() without arguments, e.g. from an event handler or at exit
+  static void setOutputFile(const std::string& filename);
+  static bool write();
+  static bool write(const std::string& filename);
+
+ private:
+  static std::atomic<bool> s_enabled;
+};
+
+// Records the lifetime of the scope as a span, name must be a string literal
+class OculusTraceScope {
+ public:
+  OculusTraceScope(const char* name, long long frameIndex) :
+      m_name(name),
+      m_frameIndex(frameIndex),
+      m_start(OculusTrace::enabled() ? osg::Timer::instance()->tick() : 0) {}
+
+  ~OculusTraceScope() {
+    if (m_start != 0) {
+      OculusTrace::record(m_name, m_frameIndex, m_start, osg::Timer::instance()->tick());
+    }
+  }
+
+ private:
+  OculusTraceScope(const OculusTraceScope&) = delete;
+  OculusTraceScope& operator=(const OculusTraceScope&) = delete;
+
+  const char* m_name;
+  long long m_frameIndex;
+  osg::Timer_t m_start;
+};
+
+#endif /* _OSG_OCULUSTRACE_H_ */
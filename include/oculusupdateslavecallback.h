@@ -15,7 +15,7 @@ class OculusDevice;
 class OculusSwapCallback;
 
 struct OculusUpdateSlaveCallback : public osg::View::Slave::UpdateSlaveCallback {
-  enum CameraType { LEFT_CAMERA, RIGHT_CAMERA };
+  enum CameraType { LEFT_CAMERA, RIGHT_CAMERA, STEREO_CAMERA };
 
   OculusUpdateSlaveCallback(CameraType cameraType,
                             OculusDevice* device,
@@ -30,6 +30,10 @@ struct OculusUpdateSlaveCallback : public osg::View::Slave::UpdateSlaveCallback
   CameraType m_cameraType;
   osg::observer_ptr<OculusDevice> m_device;
   osg::observer_ptr<OculusSwapCallback> m_swapCallback;
+  // Settings of the camera replaced while idle, restored when leaving idle
+  bool m_idle = {false};
+  GLbitfield m_clearMask = {0};
+  unsigned int m_inheritanceMask = {0};
 };
 
 #endif  // _OSG_OCULUSUPDATESLAVECALLBACK_H_
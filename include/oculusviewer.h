@@ -8,8 +8,13 @@
 #ifndef _OSG_OCULUSVIEWER_H_
 #define _OSG_OCULUSVIEWER_H_
 
+#include <osg/Camera>
 #include <osg/Group>
 
+#include <vector>
+
+#include <oculuslodcontroller.h>
+
 // Forward declaration
 namespace osgViewer {
 class Viewer;
@@ -17,26 +22,55 @@ class Viewer;
 
 class OculusDevice;
 class OculusRealizeOperation;
+class OculusSwapCallback;
 
 class OculusViewer : public osg::Group {
  public:
   OculusViewer(osgViewer::Viewer* viewer,
                OculusDevice* dev,
-               OculusRealizeOperation* realizeOperation) :
-      osg::Group(),
-      m_viewer(viewer),
-      m_device(dev),
-      m_realizeOperation(realizeOperation) {}
+               OculusRealizeOperation* realizeOperation);
   void traverse(osg::NodeVisitor& nv) override;
 
- private:
+  // Adds the eye cameras to the viewer. Called by the realize operation, before the viewer starts
+  // its threads, so that the threading model can be set up for the eye cameras.
   void configure();
 
+  // Cull the eye cameras in parallel, each on a thread of its own, and draw on the thread of the
+  // graphics context. Switches the viewer to CullThreadPerCameraDrawThreadPerContext.
+  // Must be set before the viewer is realized
+  void setParallelCull(bool enabled);
+
+  bool parallelCull() const {
+    return m_parallelCull;
+  }
+
+  // Raise the LOD scale of the eye cameras up to maxLODScale while frames run over budget, and
+  // lower it again when there is headroom. A positive maxPixelSize also enables small feature
+  // culling, raising the pixel size from minPixelSize. Both eyes always get the same values.
+  // Must be set before the viewer is realized
+  void setLODControl(bool enabled,
+                     float maxLODScale = 4.0f,
+                     float minPixelSize = 2.0f,
+                     float maxPixelSize = 0.0f);
+
+  // The level of detail controller, or null when disabled
+  OculusLODController* lodController() const {
+    return m_lodController.get();
+  }
+
+ private:
+  void configureSeparateCameras(const osg::Vec4& clearColor, OculusSwapCallback* swapCallback);
+  void updateLOD();
+
   bool m_configured = {false};
+  bool m_parallelCull = {false};
 
   osg::observer_ptr<osgViewer::Viewer> m_viewer;
   osg::observer_ptr<OculusDevice> m_device;
   osg::observer_ptr<OculusRealizeOperation> m_realizeOperation;
+  osg::ref_ptr<OculusLODController> m_lodController;
+  std::vector<osg::observer_ptr<osg::Camera>> m_eyeCameras;  // cameras drawing the eyes
+  bool m_smallFeatureCulling = {false};
 };
 
 #endif /* _OSG_OCULUSVIEWER_H_ */
@@ -0,0 +1,353 @@
+/*
+ * benchmark.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ *
+ *  Runs the full rendering pipeline headless against the stub runtime and reports the frame
+ *  times of each stage for a set of standard scenes.
+ */
+
+#include <osg/Geode>
+#include <osg/ShapeDrawable>
+#include <osgViewer/Viewer>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <oculusdevice.h>
+#include <oculusgputimer.h>
+#include <oculusgraphicsoperation.h>
+#include <oculusposestream.h>
+#include <oculustrace.h>
+#include <oculusviewer.h>
+#include <ovrstub.h>
+
+// Number of frames the GPU timers lag behind the frame being rendered
+static const unsigned int s_gpuTimerLatency = 5;
+
+// Frames rendered before measuring, to let allocations and shader compilation settle
+static const unsigned int s_warmupFrames = 30;
+
+// Grid of boxes in front of the viewer, a side of zero gives an empty scene
+static osg::Node* createScene(int side) {
+  osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+  const float spacing = 0.5f;
+  const float offset = 0.5f * spacing * (side - 1);
+
+  for (int row = 0; row < side; ++row) {
+    for (int column = 0; column < side; ++column) {
+      const osg::Vec3 center(column * spacing - offset, row * spacing - offset, -5.0f);
+      geode->addDrawable(new osg::ShapeDrawable(new osg::Box(center, 0.3f * spacing)));
+    }
+  }
+
+  return geode.release();
+}
+
+static void printUsage() {
+  std::cout << "Usage: OculusViewerBenchmark [options]\n"
+            << "  --frames <n>            Number of measured frames, 1000 by default\n"
+            << "  --scene <name>          empty, boxes (20x20) or many-boxes (100x100)\n"
+            << "  --refresh-rate <hz>     Refresh rate of the simulated display, 90 by default\n"
+            << "  --no-frame-pacing       Render as fast as possible\n"
+            << "  --shared-cull           Cull both eyes in a single traversal\n"
+            << "  --multiview             Draw both eyes in a single pass with GL_OVR_multiview2\n"
+            << "  --parallel-cull         Cull the eyes in parallel on threads of their own\n"
+            << "  --late-latch            Sample the eye poses again right before drawing\n"
+            << "  --texture-array         Render both eyes into a single texture array\n"
+            << "  --side-by-side          Render both eyes side by side into a single texture\n"
+            << "  --hidden-area-mask      Skip the pixels hidden by the lenses\n"
+            << "  --dynamic-resolution    Scale the rendered resolution to hold the frame rate\n"
+            << "  --color-format <name>   rgba8 (sRGB, default), r11g11b10f or rgba16f\n"
+            << "  --depth-format <name>   d32f (default), d24s8 or d16\n"
+            << "  --mirror <name>         both (default), left, right, distorted or off\n"
+            << "  --mirror-interval <n>   Update the mirror window every n frames\n"
+            << "  --record-poses <file>   Record the head motion and controller input\n"
+            << "  --replay-poses <file>   Replay a recorded head motion and controller input\n"
+            << "  --trace <file>          Record a timeline of the frame loop\n"
+            << "  --DrawThreadPerContext  Or any other osgViewer threading model" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  osg::ArgumentParser arguments(&argc, argv);
+
+  if (arguments.read("-h") || arguments.read("--help")) {
+    printUsage();
+    return 0;
+  }
+
+  unsigned int frames = 1000;
+  arguments.read("--frames", frames);
+
+  std::string sceneName = "boxes";
+  arguments.read("--scene", sceneName);
+
+  float refreshRate = 90.0f;
+  if (arguments.read("--refresh-rate", refreshRate)) {
+    ovrStub_SetDisplayRefreshRate(refreshRate);
+  }
+
+  if (arguments.read("--no-frame-pacing")) {
+    ovrStub_SetFramePacing(false);
+  }
+
+  bool sharedCull = arguments.read("--shared-cull");
+  bool multiview = arguments.read("--multiview");
+  bool parallelCull = arguments.read("--parallel-cull");
+  bool lateLatching = arguments.read("--late-latch");
+  bool textureArray = arguments.read("--texture-array");
+  bool sideBySide = arguments.read("--side-by-side");
+  bool hiddenAreaMask = arguments.read("--hidden-area-mask");
+  bool dynamicResolution = arguments.read("--dynamic-resolution");
+
+  std::string colorFormat = "rgba8";
+  arguments.read("--color-format", colorFormat);
+
+  std::string depthFormat = "d32f";
+  arguments.read("--depth-format", depthFormat);
+
+  std::string mirrorName = "both";
+  arguments.read("--mirror", mirrorName);
+
+  unsigned int mirrorInterval = 1;
+  arguments.read("--mirror-interval", mirrorInterval);
+
+  std::string recordPosesFile;
+  arguments.read("--record-poses", recordPosesFile);
+
+  std::string replayPosesFile;
+  arguments.read("--replay-poses", replayPosesFile);
+
+  std::string traceFile;
+  if (arguments.read("--trace", traceFile)) {
+    OculusTrace::setOutputFile(traceFile);
+    OculusTrace::enable();
+  }
+
+  int side = 0;
+  if (sceneName == "boxes") {
+    side = 20;
+  } else if (sceneName == "many-boxes") {
+    side = 100;
+  } else if (sceneName != "empty") {
+    osg::notify(osg::FATAL) << "Error: Unknown scene " << sceneName << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  OculusDevice::ColorFormat color = OculusDevice::ColorFormat::RGBA8_SRGB;
+  if (colorFormat == "r11g11b10f") {
+    color = OculusDevice::ColorFormat::R11G11B10_FLOAT;
+  } else if (colorFormat == "rgba16f") {
+    color = OculusDevice::ColorFormat::RGBA16_FLOAT;
+  } else if (colorFormat != "rgba8") {
+    osg::notify(osg::FATAL) << "Error: Unknown color format " << colorFormat << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  OculusDevice::DepthFormat depth = OculusDevice::DepthFormat::DEPTH32_FLOAT;
+  if (depthFormat == "d24s8") {
+    depth = OculusDevice::DepthFormat::DEPTH24_STENCIL8;
+  } else if (depthFormat == "d16") {
+    depth = OculusDevice::DepthFormat::DEPTH16;
+  } else if (depthFormat != "d32f") {
+    osg::notify(osg::FATAL) << "Error: Unknown depth format " << depthFormat << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  OculusDevice::MirrorMode mirror = OculusDevice::MirrorMode::MIRROR_BOTH_EYES;
+  if (mirrorName == "left") {
+    mirror = OculusDevice::MirrorMode::MIRROR_LEFT_EYE;
+  } else if (mirrorName == "right") {
+    mirror = OculusDevice::MirrorMode::MIRROR_RIGHT_EYE;
+  } else if (mirrorName == "distorted") {
+    mirror = OculusDevice::MirrorMode::MIRROR_DISTORTED;
+  } else if (mirrorName == "off") {
+    mirror = OculusDevice::MirrorMode::MIRROR_DISABLED;
+  } else if (mirrorName != "both") {
+    osg::notify(osg::FATAL) << "Error: Unknown mirror mode " << mirrorName << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  osg::ref_ptr<OculusDevice> oculusDevice = new OculusDevice(
+    0.01f, 10000.0f, 1.0f, 1.0f, 4, OculusDevice::TrackingOrigin::EYE_LEVEL, 960, false);
+
+  oculusDevice->setTextureFormats(color, depth);
+  oculusDevice->setMirrorMode(mirror);
+  oculusDevice->setMirrorRefresh(mirrorInterval);
+
+  if (multiview) {
+    oculusDevice->setStereoMode(OculusDevice::StereoMode::MULTIVIEW);
+  } else if (sharedCull) {
+    oculusDevice->setStereoMode(OculusDevice::StereoMode::SHARED_CULL);
+  }
+
+  if (textureArray) {
+    oculusDevice->setTextureLayout(OculusDevice::TextureLayout::TEXTURE_ARRAY);
+  } else if (sideBySide) {
+    oculusDevice->setTextureLayout(OculusDevice::TextureLayout::SIDE_BY_SIDE);
+  }
+
+  if (hiddenAreaMask) {
+    oculusDevice->setHiddenAreaMask(true);
+  }
+
+  if (lateLatching) {
+    oculusDevice->setLateLatching(true);
+  }
+
+  if (dynamicResolution) {
+    oculusDevice->setDynamicResolution(true, 0.5f, true);
+  }
+
+  if (!replayPosesFile.empty()) {
+    osg::ref_ptr<OculusPoseStream> poses =
+      new OculusPoseStream(replayPosesFile, OculusPoseStream::REPLAY);
+
+    if (!poses->valid()) {
+      osg::notify(osg::FATAL) << "Error: Unable to replay poses from " << replayPosesFile
+                              << std::endl;
+      return 1;
+    }
+
+    oculusDevice->setPoseStream(poses.get());
+  } else if (!recordPosesFile.empty()) {
+    oculusDevice->setPoseStream(new OculusPoseStream(recordPosesFile, OculusPoseStream::RECORD));
+  }
+
+  if (!oculusDevice->hmdPresent()) {
+    osg::notify(osg::FATAL) << "Error: No valid HMD present!" << std::endl;
+    return 1;
+  }
+
+  // Render into a pbuffer, so no window system is needed
+  osg::ref_ptr<osg::GraphicsContext::Traits> traits = oculusDevice->graphicsContextTraits();
+
+  if (!traits) {
+    osg::notify(osg::FATAL) << "Error: Unable to get the graphics context traits" << std::endl;
+    return 1;
+  }
+
+  traits->pbuffer = true;
+  traits->windowDecoration = false;
+  traits->doubleBuffer = false;
+
+  osg::ref_ptr<osg::GraphicsContext> gc = osg::GraphicsContext::createGraphicsContext(traits.get());
+
+  if (!gc) {
+    osg::notify(osg::FATAL) << "Error: Unable to create a pbuffer context" << std::endl;
+    return 1;
+  }
+
+  gc->setClearColor(osg::Vec4(0.2f, 0.2f, 0.4f, 1.0f));
+  gc->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  osgViewer::Viewer viewer(arguments);
+  if (viewer.getThreadingModel() == osgViewer::Viewer::AutomaticSelection) {
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+  }
+  viewer.getCamera()->setGraphicsContext(gc.get());
+  viewer.getCamera()->setViewport(0, 0, traits->width, traits->height);
+  viewer.getCamera()->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+
+  osg::ref_ptr<OculusRealizeOperation> oculusRealizeOperation =
+    new OculusRealizeOperation(oculusDevice);
+  viewer.setRealizeOperation(oculusRealizeOperation.get());
+
+#if (OSG_VERSION_GREATER_OR_EQUAL(3, 5, 4))
+  osg::ref_ptr<OculusCleanUpOperation> oculusCleanUpOperation =
+    new OculusCleanUpOperation(oculusDevice);
+  viewer.setCleanUpOperation(oculusCleanUpOperation.get());
+#endif
+
+  osg::ref_ptr<OculusViewer> oculusViewer =
+    new OculusViewer(&viewer, oculusDevice.get(), oculusRealizeOperation.get());
+  oculusViewer->setParallelCull(parallelCull);
+  oculusViewer->addChild(createScene(side));
+  viewer.setSceneData(oculusViewer.get());
+
+  // The GPU timers only report to the viewer stats when they collect
+  osg::Stats* stats = viewer.getViewerStats();
+  stats->collectStats("gpu", true);
+  viewer.realize();
+
+  const OculusGpuTimer::Stage stages[] = {OculusGpuTimer::LEFT_EYE,
+                                          OculusGpuTimer::RIGHT_EYE,
+                                          OculusGpuTimer::BOTH_EYES,
+                                          OculusGpuTimer::MSAA_RESOLVE,
+                                          OculusGpuTimer::MIRROR_BLIT};
+  const unsigned int stageCount = sizeof(stages) / sizeof(stages[0]);
+
+  std::vector<double> frameTimes;
+  frameTimes.reserve(frames);
+  double gpuTotals[stageCount] = {};
+  unsigned int gpuSamples[stageCount] = {};
+
+  const osg::Timer* timer = osg::Timer::instance();
+
+  for (unsigned int i = 0; i < s_warmupFrames + frames && !viewer.done(); ++i) {
+    const osg::Timer_t start = timer->tick();
+    viewer.frame();
+    const osg::Timer_t end = timer->tick();
+
+    if (i < s_warmupFrames) {
+      continue;
+    }
+
+    frameTimes.push_back(timer->delta_m(start, end));
+
+    // Read the GPU times of an earlier frame, which the timers have had time to collect
+    const unsigned int frameNumber = viewer.getFrameStamp()->getFrameNumber();
+    if (frameNumber < s_gpuTimerLatency) {
+      continue;
+    }
+
+    for (unsigned int stage = 0; stage < stageCount; ++stage) {
+      double value = 0.0;
+      if (stats->getAttribute(frameNumber - s_gpuTimerLatency,
+                              OculusGpuTimer::attributeName(stages[stage]),
+                              value)) {
+        gpuTotals[stage] += value * 1000.0;
+        ++gpuSamples[stage];
+      }
+    }
+  }
+
+  if (OculusTrace::enabled()) {
+    OculusTrace::write();
+  }
+
+  if (frameTimes.empty()) {
+    osg::notify(osg::FATAL) << "Error: No frames were rendered" << std::endl;
+    return 1;
+  }
+
+  double total = 0.0;
+  for (double frameTime : frameTimes) {
+    total += frameTime;
+  }
+
+  std::vector<double> sorted(frameTimes);
+  std::sort(sorted.begin(), sorted.end());
+  const double percentile95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Scene: " << sceneName << ", frames: " << frameTimes.size() << std::endl;
+  std::cout << "CPU frame time average: " << total / frameTimes.size() << " ms" << std::endl;
+  std::cout << "CPU frame time 95th percentile: " << percentile95 << " ms" << std::endl;
+
+  for (unsigned int stage = 0; stage < stageCount; ++stage) {
+    if (gpuSamples[stage] > 0) {
+      std::cout << OculusGpuTimer::attributeName(stages[stage]) << ": "
+                << gpuTotals[stage] / gpuSamples[stage] << " ms" << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * oculuscubelayer.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <oculuscubelayer.h>
+
+OculusCubeLayer::OculusCubeLayer(osg::TextureCubeMap* cubeMap) : m_cubeMap(cubeMap) {
+  m_layer = {};
+  m_layer.Header.Type = ovrLayerType_Cube;
+  m_layer.Header.Flags = 0;
+  m_layer.Orientation.w = 1.0f;
+}
+
+void OculusCubeLayer::setOrientation(const osg::Quat& orientation) {
+  m_layer.Orientation.x = orientation.x();
+  m_layer.Orientation.y = orientation.y();
+  m_layer.Orientation.z = orientation.z();
+  m_layer.Orientation.w = orientation.w();
+}
+
+void OculusCubeLayer::setup(ovrSession session, osg::State& state) {
+  if (!m_cubeMap.valid()) {
+    return;
+  }
+
+  const osg::Image* first = m_cubeMap->getImage(osg::TextureCubeMap::POSITIVE_X);
+
+  for (unsigned int face = 0; face < 6; ++face) {
+    const osg::Image* image = m_cubeMap->getImage(face);
+
+    if (!image || !image->data() || image->s() != image->t() || image->s() != first->s()) {
+      osg::notify(osg::WARN) << "Warning: Cube layer needs six square images of the same size!"
+                             << std::endl;
+      m_cubeMap = nullptr;
+      return;
+    }
+  }
+
+  ovrTextureSwapChainDesc desc = {};
+  desc.Type = ovrTexture_Cube;
+  desc.ArraySize = 6;
+  desc.Width = first->s();
+  desc.Height = first->t();
+  desc.MipLevels = 1;
+  desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+  desc.SampleCount = 1;
+  desc.StaticImage = ovrTrue;
+
+  ovrResult result = ovr_CreateTextureSwapChainGL(session, &desc, &m_swapChain);
+
+  if (!OVR_SUCCESS(result)) {
+    osg::notify(osg::WARN) << "Warning: Unable to create cube layer swap texture set!"
+                           << std::endl;
+    m_swapChain = nullptr;
+    m_cubeMap = nullptr;
+    return;
+  }
+
+  // A static swap chain has a single image, written once and committed once
+  GLuint texId = 0;
+  ovr_GetTextureSwapChainBufferGL(session, m_swapChain, 0, &texId);
+
+  state.setActiveTextureUnit(0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texId);
+
+  for (unsigned int face = 0; face < 6; ++face) {
+    const osg::Image* image = m_cubeMap->getImage(face);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, image->getPacking());
+    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                    0,
+                    0,
+                    0,
+                    image->s(),
+                    image->t(),
+                    image->getPixelFormat(),
+                    image->getDataType(),
+                    image->data());
+  }
+
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  // The texture bound by OSG on the unit was replaced
+  state.haveAppliedTextureAttribute(0, osg::StateAttribute::TEXTURE);
+
+  ovr_CommitTextureSwapChain(session, m_swapChain);
+  m_layer.CubeMapTexture = m_swapChain;
+
+  // The compositor keeps the images, there is no need to hold on to them
+  m_cubeMap = nullptr;
+}
+
+void OculusCubeLayer::destroy(ovrSession session) {
+  if (m_swapChain) {
+    ovr_DestroyTextureSwapChain(session, m_swapChain);
+    m_swapChain = nullptr;
+  }
+}
@@ -6,17 +6,101 @@
  *
  */
 
+#include <OpenThreads/Thread>
+#include <osg/ColorMask>
+#include <osg/Depth>
+#include <osg/Program>
 #include <osg/Version>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <glextensions.h>
+#include <oculuscubelayer.h>
 #include <oculusdevice.h>
 #include <oculusdrawcallbacks.h>
+#include <oculusgputimer.h>
+#include <oculuslatelatch.h>
+#include <oculusmirrorcapture.h>
 #include <oculusmirrortexture.h>
+#include <oculusposestream.h>
+#include <oculusquadlayer.h>
+#include <oculusresolutiongovernor.h>
 #include <oculustexturebuffer.h>
 
 #ifdef _WIN32
   #include <Windows.h>
 #endif
 
+static ovrTextureFormat swapChainFormat(OculusDevice::ColorFormat format) {
+  switch (format) {
+    case OculusDevice::ColorFormat::R11G11B10_FLOAT:
+      return OVR_FORMAT_R11G11B10_FLOAT;
+    case OculusDevice::ColorFormat::RGBA16_FLOAT:
+      return OVR_FORMAT_R16G16B16A16_FLOAT;
+    default:
+      return OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+  }
+}
+
+static ovrTextureFormat swapChainFormat(OculusDevice::DepthFormat format) {
+  switch (format) {
+    case OculusDevice::DepthFormat::DEPTH24_STENCIL8:
+      return OVR_FORMAT_D24_UNORM_S8_UINT;
+    case OculusDevice::DepthFormat::DEPTH16:
+      return OVR_FORMAT_D16_UNORM;
+    default:
+      return OVR_FORMAT_D32_FLOAT;
+  }
+}
+
+static unsigned int mirrorOptions(OculusDevice::MirrorMode mode) {
+  switch (mode) {
+    case OculusDevice::MirrorMode::MIRROR_LEFT_EYE:
+      return ovrMirrorOption_LeftEyeOnly;
+    case OculusDevice::MirrorMode::MIRROR_RIGHT_EYE:
+      return ovrMirrorOption_RightEyeOnly;
+    case OculusDevice::MirrorMode::MIRROR_DISTORTED:
+      return ovrMirrorOption_PostDistortion;
+    default:
+      return ovrMirrorOption_Default;
+  }
+}
+
+// Minimal multiview shader for scenes without shaders of their own, vertex colors with a light
+// along the view direction
+static const char* s_multiviewVertexShader =
+  "#version 330 compatibility\n"
+  "#extension GL_OVR_multiview2 : require\n"
+  "layout(num_views = 2) in;\n"
+  "uniform mat4 oculus_ViewMatrix[2];\n"
+  "uniform mat4 oculus_ProjectionMatrix[2];\n"
+  "out vec4 oculus_Color;\n"
+  "void main() {\n"
+  "  vec4 position = oculus_ViewMatrix[gl_ViewID_OVR] * gl_ModelViewMatrix * gl_Vertex;\n"
+  "  mat3 normalMatrix = mat3(oculus_ViewMatrix[gl_ViewID_OVR]) * gl_NormalMatrix;\n"
+  "  vec3 normal = normalize(normalMatrix * gl_Normal);\n"
+  "  float diffuse = max(dot(normal, normalize(-position.xyz)), 0.0);\n"
+  "  oculus_Color = vec4(gl_Color.rgb * (0.2 + 0.8 * diffuse), gl_Color.a);\n"
+  "  gl_Position = oculus_ProjectionMatrix[gl_ViewID_OVR] * position;\n"
+  "}\n";
+
+static const char* s_multiviewFragmentShader =
+  "#version 330 compatibility\n"
+  "in vec4 oculus_Color;\n"
+  "void main() {\n"
+  "  gl_FragColor = oculus_Color;\n"
+  "}\n";
+
+static osg::Program* createMultiviewProgram() {
+  osg::Program* program = new osg::Program();
+  program->setName("OculusMultiview");
+  program->addShader(new osg::Shader(osg::Shader::VERTEX, s_multiviewVertexShader));
+  program->addShader(new osg::Shader(osg::Shader::FRAGMENT, s_multiviewFragmentShader));
+  return program;
+}
+
 OculusDevice::OculusDevice(float nearClip,
                            float farClip,
                            const float pixelsPerDisplayPixel,
@@ -66,19 +150,107 @@ void OculusDevice::createRenderBuffers(osg::State* state) {
                            << std::endl;
   }
 
+  if (m_stereoMode == MULTIVIEW) {
+    const OculusGLExtensions* ext = getOculusGLExtensions(*state);
+
+    if (!ext->isMultiviewSupported) {
+      osg::notify(osg::WARN) << "Warning: GL_OVR_multiview2 not supported, "
+                             << "falling back to separate cameras." << std::endl;
+      m_stereoMode = SEPARATE_CAMERAS;
+    }
+  }
+
+  ovrSizei recommenedTextureSize[2];
   for (int i = 0; i < 2; i++) {
-    ovrSizei recommenedTextureSize = ovr_GetFovTextureSize(m_session,
-                                                           (ovrEyeType)i,
-                                                           m_hmdDesc.DefaultEyeFov[i],
-                                                           m_pixelsPerDisplayPixel);
-    m_textureBuffer[i] =
-      new OculusTextureBuffer(m_session, state, recommenedTextureSize, m_samples);
+    recommenedTextureSize[i] = ovr_GetFovTextureSize(m_session,
+                                                     (ovrEyeType)i,
+                                                     m_hmdDesc.DefaultEyeFov[i],
+                                                     m_pixelsPerDisplayPixel);
   }
 
-  // compute mirror texture height based on requested with and respecting the Oculus screen ar
-  int height =
-    (float)m_mirrorTextureWidth / (float)screenResolutionWidth() * (float)screenResolutionHeight();
-  m_mirrorTexture = new OculusMirrorTexture(m_session, state, m_mirrorTextureWidth, height);
+  if (m_stereoMode == MULTIVIEW) {
+    m_textureLayout = TEXTURE_ARRAY;
+  }
+
+  if (m_stereoMode != SEPARATE_CAMERAS || m_textureLayout != TEXTURE_PER_EYE) {
+    // Both eyes share a viewport or a texture, so use a size fitting the larger eye
+    ovrSizei size;
+    size.w = std::max(recommenedTextureSize[0].w, recommenedTextureSize[1].w);
+    size.h = std::max(recommenedTextureSize[0].h, recommenedTextureSize[1].h);
+    recommenedTextureSize[0] = size;
+    recommenedTextureSize[1] = size;
+  }
+
+  const ovrTextureFormat colorFormat = swapChainFormat(m_colorFormat);
+  const ovrTextureFormat depthFormat = swapChainFormat(m_depthFormat);
+
+  if (m_textureLayout == TEXTURE_ARRAY) {
+    // Both eyes share one layered texture
+    m_textureBuffer[0] = new OculusTextureBuffer(m_session,
+                                                 state,
+                                                 recommenedTextureSize[0],
+                                                 m_samples,
+                                                 2,
+                                                 false,
+                                                 colorFormat,
+                                                 depthFormat);
+    m_textureBuffer[1] = m_textureBuffer[0];
+  } else if (m_textureLayout == SIDE_BY_SIDE) {
+    // Both eyes share one double width texture
+    ovrSizei size = recommenedTextureSize[0];
+    size.w *= 2;
+    m_textureBuffer[0] = new OculusTextureBuffer(
+      m_session, state, size, m_samples, 1, true, colorFormat, depthFormat);
+    m_textureBuffer[1] = m_textureBuffer[0];
+  } else {
+    for (int i = 0; i < 2; i++) {
+      m_textureBuffer[i] = new OculusTextureBuffer(m_session,
+                                                   state,
+                                                   recommenedTextureSize[i],
+                                                   m_samples,
+                                                   1,
+                                                   false,
+                                                   colorFormat,
+                                                   depthFormat);
+    }
+  }
+
+  if (m_mirrorMode != MIRROR_DISABLED) {
+    // compute mirror texture height based on requested with and respecting the Oculus screen ar,
+    // a single eye covers half the screen
+    const bool singleEye = m_mirrorMode == MIRROR_LEFT_EYE || m_mirrorMode == MIRROR_RIGHT_EYE;
+    const float screenWidth = singleEye ? 0.5f * screenResolutionWidth() : screenResolutionWidth();
+    int height = (float)m_mirrorTextureWidth / screenWidth * (float)screenResolutionHeight();
+    m_mirrorTexture = new OculusMirrorTexture(m_session,
+                                              state,
+                                              m_mirrorTextureWidth,
+                                              height,
+                                              swapChainFormat(m_mirrorFormat),
+                                              mirrorOptions(m_mirrorMode));
+    m_mirrorTexture->setCapture(m_mirrorCapture.get());
+  } else if (m_mirrorCapture.valid()) {
+    osg::notify(osg::WARN) << "Warning: The mirror can not be captured when disabled."
+                           << std::endl;
+  }
+
+  if (getOculusGLExtensions(*state)->isTimerQuerySupported) {
+    m_gpuTimer = new OculusGpuTimer(*state);
+  }
+
+  if (m_lateLatching && replayingPoses()) {
+    osg::notify(osg::WARN) << "Warning: Late latching disabled while replaying poses." << std::endl;
+  } else if (m_lateLatching) {
+    if (getOculusGLExtensions(*state)->isPersistentMappingSupported) {
+      m_lateLatch = new OculusLateLatch(*state);
+    } else {
+      osg::notify(osg::WARN) << "Warning: Persistently mapped buffers not supported, "
+                             << "late latching disabled." << std::endl;
+    }
+  }
+
+  if (m_cubeLayer.valid()) {
+    m_cubeLayer->setup(m_session, *state);
+  }
 }
 
 void OculusDevice::init() {
@@ -86,8 +258,17 @@ void OculusDevice::init() {
 
   getEyeRenderDesc();
 
+  setupFrameData();
+
   setupLayers();
 
+  setupHiddenAreaMeshes();
+
+  if (m_dynamicResolution) {
+    m_resolutionGovernor = new OculusResolutionGovernor(m_minViewportScale, 1.0f, m_samples);
+    m_resolutionGovernor->setDynamicSamples(m_dynamicSamples);
+  }
+
   // Reset perf hud
   ovr_SetInt(m_session, "PerfHudMode", (int)ovrPerfHud_Off);
 }
@@ -104,6 +285,27 @@ void OculusDevice::destroyTextures(osg::GraphicsContext* gc) {
       m_textureBuffer[i]->destroy(gc);
     }
   }
+
+  // Delete timer queries
+  if (m_gpuTimer.valid() && gc) {
+    m_gpuTimer->destroy(*gc->getState());
+    m_gpuTimer = nullptr;
+  }
+
+  // Delete late latch buffer
+  if (m_lateLatch.valid() && gc) {
+    m_lateLatch->destroy(*gc->getState());
+    m_lateLatch = nullptr;
+  }
+
+  // Delete cube and quad layer swap chains
+  if (m_cubeLayer.valid()) {
+    m_cubeLayer->destroy(m_session);
+  }
+
+  for (const osg::ref_ptr<OculusQuadLayer>& layer : m_quadLayers) {
+    layer->destroy(m_session, gc);
+  }
 }
 
 bool OculusDevice::hmdPresent() const {
@@ -125,10 +327,35 @@ bool OculusDevice::hmdPresent() const {
   return false;
 }
 
+long long OculusDevice::advanceFrameIndex() {
+  const long long frameIndex = ++m_updateFrameIndex;
+
+  if (frameIndex - m_drawFrameIndex >= FRAME_DATA_COUNT) {
+    osg::notify(osg::WARN) << "Warning: Frame " << frameIndex << " is updated more than "
+                           << FRAME_DATA_COUNT - 1 << " frames ahead of the draw." << std::endl;
+  }
+
+  // Start from the settings of the previous frame, the pose is filled in by updatePose(). The
+  // previous frame may be drawing, and late latching its poses, at the same time.
+  OculusFrameData& frame = frameData(frameIndex);
+  {
+    std::lock_guard<std::mutex> lock(m_lateLatchMutex);
+    frame = frameData(frameIndex - 1);
+  }
+  frame.frameIndex = frameIndex;
+  frame.begunFrame = false;
+  frame.lateLatched = false;
+  return frameIndex;
+}
+
 void OculusDevice::updatePose(long long frameIndex) {
+  OculusFrameData& frame = frameData(frameIndex);
+
   // Call getEyeRenderDesc() each frame, since the returned values (e.g. HmdToEyePose) may change at
   // runtime.
   getEyeRenderDesc();
+  frame.eyeRenderDesc[0] = m_eyeRenderDesc[0];
+  frame.eyeRenderDesc[1] = m_eyeRenderDesc[1];
   ovrPosef HmdToEyePose[2] = {m_eyeRenderDesc[0].HmdToEyePose, m_eyeRenderDesc[1].HmdToEyePose};
 
   // Update the tracking state
@@ -136,8 +363,20 @@ void OculusDevice::updatePose(long long frameIndex) {
                   frameIndex,
                   ovrTrue,
                   HmdToEyePose,
-                  m_eyeRenderPose,
-                  &m_sensorSampleTime);
+                  frame.eyeRenderPose,
+                  &frame.sensorSampleTime);
+
+  if (replayingPoses()) {
+    // The runtime is still sampled, so that the frame keeps its sample time and latency marker
+    const OculusPoseSample& sample = m_poseStream->read();
+    frame.eyeRenderPose[0] = sample.eyeRenderPose[0];
+    frame.eyeRenderPose[1] = sample.eyeRenderPose[1];
+    m_controllerState = sample.controllerState;
+    m_headPose = sample.headPose;
+    m_handPoses[ovrHand_Left] = sample.handPoses[ovrHand_Left];
+    m_handPoses[ovrHand_Right] = sample.handPoses[ovrHand_Right];
+    return;
+  }
 
   // Update touch controllers
   ovr_GetInputState(m_session, ovrControllerType_Touch, &m_controllerState);
@@ -147,38 +386,48 @@ void OculusDevice::updatePose(long long frameIndex) {
   m_headPose = trackingState.HeadPose;
   m_handPoses[ovrHand_Left] = trackingState.HandPoses[ovrHand_Left];
   m_handPoses[ovrHand_Right] = trackingState.HandPoses[ovrHand_Right];
-}
 
-osg::Vec3 OculusDevice::position(Eye eye) const {
-  return osg::Vec3(m_eyeRenderPose[eye].Position.x,
-                   m_eyeRenderPose[eye].Position.y,
-                   m_eyeRenderPose[eye].Position.z);
+  if (m_poseStream.valid() && m_poseStream->mode() == OculusPoseStream::RECORD) {
+    OculusPoseSample sample = {};
+    sample.eyeRenderPose[0] = frame.eyeRenderPose[0];
+    sample.eyeRenderPose[1] = frame.eyeRenderPose[1];
+    sample.headPose = m_headPose;
+    sample.handPoses[ovrHand_Left] = m_handPoses[ovrHand_Left];
+    sample.handPoses[ovrHand_Right] = m_handPoses[ovrHand_Right];
+    sample.controllerState = m_controllerState;
+    m_poseStream->write(sample);
+  }
 }
 
-osg::Quat OculusDevice::orientation(Eye eye) const {
-  return osg::Quat(m_eyeRenderPose[eye].Orientation.x,
-                   m_eyeRenderPose[eye].Orientation.y,
-                   m_eyeRenderPose[eye].Orientation.z,
-                   m_eyeRenderPose[eye].Orientation.w);
+void OculusDevice::setPoseStream(OculusPoseStream* stream) {
+  m_poseStream = stream;
 }
 
-osg::Matrixf OculusDevice::viewMatrix(Eye eye) const {
-  osg::Matrix viewMatrix;
+bool OculusDevice::replayingPoses() const {
+  return m_poseStream.valid() && m_poseStream->mode() == OculusPoseStream::REPLAY &&
+         m_poseStream->valid();
+}
 
-  // invert orientation (conjugate of Quaternion) and position to apply to the view matrix as offset
-  viewMatrix.setTrans(-position(eye));
-  viewMatrix.postMultRotate(orientation(eye).conj());
+osg::Vec3 OculusDevice::position(Eye eye, const OculusFrameData& frame) const {
+  return osg::Vec3(frame.eyeRenderPose[eye].Position.x,
+                   frame.eyeRenderPose[eye].Position.y,
+                   frame.eyeRenderPose[eye].Position.z);
+}
 
-  // Scale to world units
-  viewMatrix.postMultScale(
-    osg::Vec3d(m_worldUnitsPerMetre, m_worldUnitsPerMetre, m_worldUnitsPerMetre));
+osg::Quat OculusDevice::orientation(Eye eye, const OculusFrameData& frame) const {
+  return osg::Quat(frame.eyeRenderPose[eye].Orientation.x,
+                   frame.eyeRenderPose[eye].Orientation.y,
+                   frame.eyeRenderPose[eye].Orientation.z,
+                   frame.eyeRenderPose[eye].Orientation.w);
+}
 
-  return viewMatrix;
+osg::Matrixf OculusDevice::viewMatrix(Eye eye, const OculusFrameData& frame) const {
+  return viewMatrix(position(eye, frame), orientation(eye, frame));
 }
 
-osg::Matrixf OculusDevice::projectionMatrix(Eye eye) const {
+osg::Matrixf OculusDevice::projectionMatrix(Eye eye, const OculusFrameData& frame) const {
   osg::Matrix projectionMatrix;
-  ovrMatrix4f ovrProjectionMatrix = ovrMatrix4f_Projection(m_eyeRenderDesc[eye].Fov,
+  ovrMatrix4f ovrProjectionMatrix = ovrMatrix4f_Projection(frame.eyeRenderDesc[eye].Fov,
                                                            m_nearClip,
                                                            m_farClip,
                                                            ovrProjection_ClipRangeOpenGL);
@@ -204,56 +453,462 @@ osg::Matrixf OculusDevice::projectionMatrix(Eye eye) const {
   return projectionMatrix;
 }
 
+ovrRecti OculusDevice::eyeViewport(Eye eye, const OculusFrameData& frame) const {
+  const OculusTextureBuffer* buffer = m_textureBuffer[eye].get();
+
+  ovrRecti viewport;
+  viewport.Pos.x = 0;
+  viewport.Pos.y = 0;
+  viewport.Size.w = buffer->textureWidth();
+  viewport.Size.h = buffer->textureHeight();
+
+  if (buffer->sideBySide()) {
+    viewport.Size.w /= 2;
+    viewport.Pos.x = eye * viewport.Size.w;
+  }
+
+  // Only the lower left part of the eye area is rendered when the resolution is scaled down
+  viewport.Size.w = (int)(viewport.Size.w * frame.viewportScale);
+  viewport.Size.h = (int)(viewport.Size.h * frame.viewportScale);
+
+  return viewport;
+}
+
+void OculusDevice::updatePerformanceStats(unsigned int frameNumber) {
+  // The statistics only contain the frames completed since the last call
+  if (ovr_GetPerfStats(m_session, &m_perfStats) != ovrSuccess) {
+    m_perfStats.FrameStatsCount = 0;
+    return;
+  }
+
+  if (m_perfStats.FrameStatsCount == 0) {
+    return;
+  }
+
+  const ovrPerfStatsPerCompositorFrame& frame = m_perfStats.FrameStats[0];
+  const float frameBudget = 1.0f / m_hmdDesc.DisplayRefreshRate;
+
+  m_performanceStats.frameIndex = frame.AppFrameIndex;
+  m_performanceStats.appDroppedFrameCount = frame.AppDroppedFrameCount;
+  m_performanceStats.compositorDroppedFrameCount = frame.CompositorDroppedFrameCount;
+  m_performanceStats.appMotionToPhotonLatency = frame.AppMotionToPhotonLatency;
+  m_performanceStats.aswIsAvailable = m_perfStats.AswIsAvailable == ovrTrue;
+  m_performanceStats.aswIsActive = frame.AswIsActive == ovrTrue;
+  m_performanceStats.aswActivatedToggleCount = frame.AswActivatedToggleCount;
+  m_performanceStats.aswPresentedFrameCount = frame.AswPresentedFrameCount;
+  m_performanceStats.aswFailedFrameCount = frame.AswFailedFrameCount;
+  m_performanceStats.appGpuElapsedTime = frame.AppGpuElapsedTime;
+  m_performanceStats.appGpuHeadroom = frameBudget - frame.AppGpuElapsedTime;
+  m_performanceStats.compositorCpuElapsedTime = frame.CompositorCpuElapsedTime;
+  m_performanceStats.compositorGpuElapsedTime = frame.CompositorGpuElapsedTime;
+  m_performanceStats.compositorHeadroom = frame.CompositorGpuEndToVsyncElapsedTime;
+  m_performanceStats.adaptiveGpuPerformanceScale = m_perfStats.AdaptiveGpuPerformanceScale;
+
+  osg::ref_ptr<osg::Stats> stats;
+  if (!m_stats.lock(stats) || !stats->collectStats("compositor")) {
+    return;
+  }
+
+  const OculusPerformanceStats& perf = m_performanceStats;
+  stats->setAttribute(frameNumber, "App dropped frames", perf.appDroppedFrameCount);
+  stats->setAttribute(frameNumber, "Compositor dropped frames", perf.compositorDroppedFrameCount);
+  stats->setAttribute(frameNumber, "Motion to photon latency", perf.appMotionToPhotonLatency);
+  stats->setAttribute(frameNumber, "ASW active", perf.aswIsActive ? 1.0 : 0.0);
+  stats->setAttribute(frameNumber, "ASW presented frames", perf.aswPresentedFrameCount);
+  stats->setAttribute(frameNumber, "App GPU time taken", perf.appGpuElapsedTime);
+  stats->setAttribute(frameNumber, "App GPU headroom", perf.appGpuHeadroom);
+  stats->setAttribute(frameNumber, "Compositor CPU time taken", perf.compositorCpuElapsedTime);
+  stats->setAttribute(frameNumber, "Compositor GPU time taken", perf.compositorGpuElapsedTime);
+  stats->setAttribute(frameNumber, "Compositor headroom", perf.compositorHeadroom);
+}
+
+void OculusDevice::updateDynamicResolution() {
+  if (!m_resolutionGovernor.valid()) {
+    return;
+  }
+
+  m_resolutionGovernor->update(m_perfStats, 1.0 / m_hmdDesc.DisplayRefreshRate);
+  m_viewportScale = m_resolutionGovernor->viewportScale();
+  frameData(m_updateFrameIndex).viewportScale = m_viewportScale;
+
+  if (m_samples != 0) {
+    frameData(m_updateFrameIndex).samples = m_resolutionGovernor->samples();
+  }
+}
+
+void OculusDevice::updateSessionStatus() {
+  if (!OVR_SUCCESS(ovr_GetSessionStatus(m_session, &m_sessionStatus))) {
+    return;
+  }
+
+  if (m_sessionStatus.ShouldRecenter) {
+    // Also clears the request
+    ovr_RecenterTrackingOrigin(m_session);
+  }
+
+  const bool notVisible = !m_sessionStatus.IsVisible || !m_sessionStatus.HmdMounted ||
+                          m_endFrameNotVisible;
+  frameData(m_updateFrameIndex).idle = m_idleWhenNotVisible && notVisible;
+}
+
+void OculusDevice::idle() {
+  const osg::Timer* timer = osg::Timer::instance();
+  const double period = 1.0 / m_idleFrameRate;
+  const double elapsed = timer->delta_s(m_idleTick, timer->tick());
+
+  if (elapsed < period) {
+    OpenThreads::Thread::microSleep((unsigned int)((period - elapsed) * 1.0e6));
+  }
+
+  m_idleTick = timer->tick();
+}
+
+void OculusDevice::updateMirror() {
+  OculusFrameData& frame = frameData(m_updateFrameIndex);
+  frame.mirror = false;
+
+  if (m_mirrorMode == MIRROR_DISABLED || frame.idle ||
+      m_updateFrameIndex % m_mirrorFrameInterval != 0) {
+    return;
+  }
+
+  const osg::Timer* timer = osg::Timer::instance();
+  const osg::Timer_t now = timer->tick();
+
+  if (m_mirrorMaxRate > 0.0f && timer->delta_s(m_mirrorTick, now) < 1.0 / m_mirrorMaxRate) {
+    return;
+  }
+
+  m_mirrorTick = now;
+  frame.mirror = true;
+}
+
+void OculusDevice::setMirrorCapture(OculusMirrorCapture* capture) {
+  m_mirrorCapture = capture;
+}
+
+void OculusDevice::setCubeLayer(OculusCubeLayer* layer) {
+  m_cubeLayer = layer;
+}
+
+void OculusDevice::addQuadLayer(OculusQuadLayer* layer) {
+  // The eye layer and the cube layer take two of the layers the compositor accepts
+  if (m_quadLayers.size() + 2 >= ovrMaxLayerCount) {
+    osg::notify(osg::WARN) << "Warning: Unable to add more than " << ovrMaxLayerCount - 2
+                           << " quad layers!" << std::endl;
+    return;
+  }
+
+  m_quadLayers.push_back(layer);
+}
+
+void OculusDevice::updateQuadLayers() {
+  const bool idle = updateFrame().idle;
+
+  for (const osg::ref_ptr<OculusQuadLayer>& layer : m_quadLayers) {
+    layer->update(m_updateFrameIndex, idle);
+  }
+}
+
 void OculusDevice::updateTimewarpProjection(Eye eye) {
-  ovrMatrix4f proj =
-    ovrMatrix4f_Projection(m_hmdDesc.DefaultEyeFov[eye], 0.2f, 1000.0f, ovrProjection_None);
-  m_posTimewarpProjectionDesc = ovrTimewarpProjectionDesc_FromProjection(proj, ovrProjection_None);
+  OculusFrameData& frame = frameData(m_updateFrameIndex);
+
+  // Must match the projection of projectionMatrix(), which wrote the depth buffer
+  ovrMatrix4f proj = ovrMatrix4f_Projection(frame.eyeRenderDesc[eye].Fov,
+                                            m_nearClip,
+                                            m_farClip,
+                                            ovrProjection_ClipRangeOpenGL);
+  frame.timewarpProjectionDesc =
+    ovrTimewarpProjectionDesc_FromProjection(proj, ovrProjection_ClipRangeOpenGL);
+}
+
+osg::Matrixf OculusDevice::cullViewMatrix(const OculusFrameData& frame) const {
+  const osg::Vec3 leftPosition = position(LEFT, frame);
+  const osg::Vec3 rightPosition = position(RIGHT, frame);
+  osg::Quat headOrientation;
+  headOrientation.slerp(0.5, orientation(LEFT, frame), orientation(RIGHT, frame));
+  const osg::Vec3 center = (leftPosition + rightPosition) * 0.5f;
+  const float halfSeparation = (rightPosition - leftPosition).length() * 0.5f;
+
+  // Move the cull origin back until the outer edges of both eye frustums are inside its frustum
+  const float outerTan =
+    std::min(frame.eyeRenderDesc[LEFT].Fov.LeftTan, frame.eyeRenderDesc[RIGHT].Fov.RightTan);
+  const float offset = outerTan > 0.0f ? halfSeparation / outerTan : 0.0f;
+
+  return viewMatrix(center + headOrientation * osg::Vec3(0.0f, 0.0f, offset), headOrientation);
+}
+
+osg::Matrixf OculusDevice::cullProjectionMatrix(const OculusFrameData& frame) const {
+  const osg::Matrixd cullView = cullViewMatrix(frame);
+
+  double left = std::numeric_limits<double>::max();
+  double right = -std::numeric_limits<double>::max();
+  double bottom = std::numeric_limits<double>::max();
+  double top = -std::numeric_limits<double>::max();
+  double zNear = std::numeric_limits<double>::max();
+  double zFar = 0.0;
+
+  // Fit a frustum around the corners of both eye frustums
+  for (int eye = 0; eye < 2; ++eye) {
+    const osg::Matrixd eyeToCull = osg::Matrixd::inverse(viewMatrix((Eye)eye, frame)) * cullView;
+    const ovrFovPort& fov = frame.eyeRenderDesc[eye].Fov;
+
+    for (const double depth : {(double)m_nearClip, (double)m_farClip}) {
+      for (const double x : {-fov.LeftTan * depth, fov.RightTan * depth}) {
+        for (const double y : {-fov.DownTan * depth, fov.UpTan * depth}) {
+          const osg::Vec3d corner = osg::Vec3d(x, y, -depth) * eyeToCull;
+          const double distance = -corner.z();
+          left = std::min(left, corner.x() / distance);
+          right = std::max(right, corner.x() / distance);
+          bottom = std::min(bottom, corner.y() / distance);
+          top = std::max(top, corner.y() / distance);
+          zNear = std::min(zNear, distance);
+          zFar = std::max(zFar, distance);
+        }
+      }
+    }
+  }
+
+  return osg::Matrixf::frustum(
+    left * zNear, right * zNear, bottom * zNear, top * zNear, zNear, zFar);
+}
+
+osg::Matrixf OculusDevice::stereoViewMatrix(Eye eye, const OculusFrameData& frame) const {
+  return osg::Matrixf::inverse(cullViewMatrix(frame)) * viewMatrix(eye, frame);
+}
+
+osg::Matrixf OculusDevice::stereoProjectionMatrix(Eye eye, const OculusFrameData& frame) const {
+  // The eye offset from the cull view is folded into the projection, so that both eyes can share
+  // the model view matrices computed during the cull traversal.
+  return stereoViewMatrix(eye, frame) * projectionMatrix(eye, frame);
+}
+
+bool OculusDevice::usesHiddenAreaMask() const {
+  // Layered targets would need a multiview aware mask shader, so the mask is not used for them
+  return m_hiddenAreaMask && m_stereoMode != MULTIVIEW && m_hiddenAreaMesh[0].valid() &&
+         m_hiddenAreaMesh[1].valid();
+}
+
+void OculusDevice::applyRenderSamples(osg::RenderInfo& renderInfo) const {
+  const int samples = drawFrame().samples;
+
+  if (samples == 0) {
+    return;
+  }
+
+  const osg::State& state = *renderInfo.getState();
+  m_textureBuffer[0]->setRenderSamples(state, samples);
+
+  if (m_textureBuffer[1] != m_textureBuffer[0]) {
+    m_textureBuffer[1]->setRenderSamples(state, samples);
+  }
+}
+
+void OculusDevice::drawHiddenAreaMask(osg::RenderInfo& renderInfo, Eye eye) const {
+  if (!usesHiddenAreaMask()) {
+    return;
+  }
+
+  osg::State& state = *renderInfo.getState();
+  const ovrRecti viewport = eyeViewport(eye, drawFrame());
+
+  // Clear the depth of this eye only, the same way as the render stage does its clear
+  glViewport(viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
+  state.haveAppliedAttribute(osg::StateAttribute::VIEWPORT);
+  glScissor(viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
+  state.applyMode(GL_SCISSOR_TEST, true);
+  glClearDepth(1.0);
+  glDepthMask(GL_TRUE);
+  state.haveAppliedAttribute(osg::StateAttribute::DEPTH);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  state.applyMode(GL_SCISSOR_TEST, false);
+
+  // The mesh is given in normalized device coordinates
+  state.pushStateSet(m_hiddenAreaStateSet.get());
+  state.apply();
+  state.applyProjectionMatrix(m_identityMatrix.get());
+  state.applyModelViewMatrix(m_identityMatrix.get());
+
+  m_hiddenAreaMesh[eye]->draw(renderInfo);
+
+  state.popStateSet();
+  state.apply();
+}
+
+void OculusDevice::lateLatch(osg::RenderInfo& renderInfo, int layer) {
+  if (!m_lateLatch.valid()) {
+    return;
+  }
+
+  const long long frameIndex = m_drawFrameIndex;
+  OculusFrameData& frame = frameData(frameIndex);
+
+  if (frame.frameIndex != frameIndex) {
+    return;
+  }
+
+  // Both eyes use the poses sampled before the first of them is drawn, since the compositor is
+  // given a single sample time per frame
+  if (!frame.lateLatched) {
+    ovrPosef HmdToEyePose[2] = {frame.eyeRenderDesc[0].HmdToEyePose,
+                                frame.eyeRenderDesc[1].HmdToEyePose};
+    ovrPosef lateRenderPose[2];
+    double lateSensorSampleTime = 0.0;
+    ovr_GetEyePoses(m_session,
+                    frameIndex,
+                    ovrFalse,
+                    HmdToEyePose,
+                    lateRenderPose,
+                    &lateSensorSampleTime);
+
+    std::lock_guard<std::mutex> lock(m_lateLatchMutex);
+    frame.lateRenderPose[0] = lateRenderPose[0];
+    frame.lateRenderPose[1] = lateRenderPose[1];
+    frame.lateSensorSampleTime = lateSensorSampleTime;
+    frame.lateLatched = true;
+  }
+
+  OculusFrameData lateFrame = frame;
+  lateFrame.eyeRenderPose[0] = frame.lateRenderPose[0];
+  lateFrame.eyeRenderPose[1] = frame.lateRenderPose[1];
+
+  // Eye space positions were computed with the view the camera was culled with. The correction
+  // moves them from that view to the late view, expressed in the eye space of the culled view.
+  osg::Matrixf correction[2];
+  for (int eye = 0; eye < 2; ++eye) {
+    const osg::Matrixf cullView = m_stereoMode == SEPARATE_CAMERAS ? viewMatrix((Eye)eye, frame) :
+                                                                     cullViewMatrix(frame);
+    correction[eye] = osg::Matrixf::inverse(cullView) * viewMatrix((Eye)eye, lateFrame) *
+                      osg::Matrixf::inverse(viewMatrix((Eye)eye, frame)) * cullView;
+  }
+
+  const osg::State& state = *renderInfo.getState();
+  if (layer == OculusTextureBuffer::ALL_LAYERS) {
+    m_lateLatch->apply(state, frameIndex, 0, correction[LEFT], correction[RIGHT]);
+  } else {
+    m_lateLatch->apply(state, frameIndex, layer, correction[layer], correction[layer]);
+  }
+}
+
+GLbitfield OculusDevice::eyeClearMask() const {
+  // The depth is cleared by the pre draw callback when drawing the hidden area mask
+  return usesHiddenAreaMask() ? GL_COLOR_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+}
+
+osg::Vec4 OculusDevice::eyeClearColor(const osg::Vec4& clearColor) const {
+  // Pixels not covered by the scene must let the cube layer beneath show through
+  return m_cubeLayer.valid() ? osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f) : clearColor;
 }
 
 osg::Camera* OculusDevice::createRTTCamera(OculusDevice::Eye eye,
                                            osg::Transform::ReferenceFrame referenceFrame,
                                            const osg::Vec4& clearColor,
-                                           osg::GraphicsContext* gc) const {
+                                           osg::GraphicsContext* gc) {
   osg::ref_ptr<OculusTextureBuffer> buffer = m_textureBuffer[eye];
 
   osg::ref_ptr<osg::Camera> camera = new osg::Camera();
-  camera->setClearColor(clearColor);
-  camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  camera->setClearColor(eyeClearColor(clearColor));
+  camera->setClearMask(eyeClearMask());
   camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
   camera->setRenderOrder(osg::Camera::PRE_RENDER, eye);
   camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
   camera->setAllowEventFocus(false);
   camera->setReferenceFrame(referenceFrame);
-  camera->setViewport(0, 0, buffer->textureWidth(), buffer->textureHeight());
+  const ovrRecti viewport = eyeViewport(eye);
+  camera->setViewport(viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
   camera->setGraphicsContext(gc);
 
-  if (buffer->colorBuffer()) {
-    camera->attach(osg::Camera::COLOR_BUFFER, buffer->colorBuffer());
-  }
+  // The framebuffers of the swap chain images are built by the texture buffer and bound by the
+  // pre and post render callbacks, so we don't want OSG doing anything regarding FBO setup and
+  // selection. This initial draw callback is used to disable normal OSG camera setup which would
+  // undo the binding, and the camera has no buffer attachments for the same reason.
+  camera->setInitialDrawCallback(new OculusInitialDrawCallback());
 
-  if (buffer->depthBuffer()) {
-    camera->attach(osg::Camera::DEPTH_BUFFER, buffer->depthBuffer());
-  }
+  camera->setPreDrawCallback(new OculusPreDrawCallback(camera, buffer, this, eye));
 
-  if (m_samples != 0) {
-    // If we are using MSAA, we don't want OSG doing anything regarding FBO
-    // setup and selection because this is handled completely by 'setupMSAA'
-    // and by pre and post render callbacks. So this initial draw callback is
-    // used to disable normal OSG camera setup which would undo the MSAA buffer
-    // configuration. Note that we have also implicitly avoided the camera buffer
-    // attachments above when MSAA is enabled because we don't want OSG to
-    // affect the texture bindings handled by the pre and post render callbacks.
+  camera->setFinalDrawCallback(new OculusPostDrawCallback(
+    camera, buffer, this, eye, eye == Eye::RIGHT && m_blitOnPostDraw));
+
+  return camera.release();
+}
+
+osg::Camera* OculusDevice::createStereoRTTCamera(osg::Transform::ReferenceFrame referenceFrame,
+                                                 const osg::Vec4& clearColor,
+                                                 osg::GraphicsContext* gc) {
+  osg::ref_ptr<OculusTextureBuffer> buffer = m_textureBuffer[Eye::LEFT];
+
+  osg::ref_ptr<osg::Camera> camera = new osg::Camera();
+  camera->setClearColor(eyeClearColor(clearColor));
+  camera->setClearMask(eyeClearMask());
+  camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+  camera->setRenderOrder(osg::Camera::PRE_RENDER, 0);
+  camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+  camera->setAllowEventFocus(false);
+  camera->setReferenceFrame(referenceFrame);
+  const ovrRecti viewport = eyeViewport(Eye::LEFT);
+  camera->setViewport(viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
+  camera->setGraphicsContext(gc);
+
+  if (m_stereoMode == SHARED_CULL) {
+    // The camera renders the left eye like a left eye camera,
+    // the right eye is drawn by replaying the render graph in the post draw callback.
     camera->setInitialDrawCallback(new OculusInitialDrawCallback());
-  }
 
-  camera->setPreDrawCallback(new OculusPreDrawCallback(camera, buffer));
+    camera->setPreDrawCallback(new OculusStereoPreDrawCallback(camera, buffer, this));
+
+    camera->setFinalDrawCallback(new OculusStereoPostDrawCallback(
+      camera, buffer, m_textureBuffer[Eye::RIGHT], this, m_blitOnPostDraw));
+
+    return camera.release();
+  }
 
-  camera->setFinalDrawCallback(
-    new OculusPostDrawCallback(camera, buffer, this, eye == Eye::RIGHT && m_blitOnPostDraw));
+  // The layered render target is bound by the pre and post render callbacks,
+  // so OSG must not do any FBO setup of its own for this camera.
+  camera->setInitialDrawCallback(new OculusInitialDrawCallback());
+
+  camera->setPreDrawCallback(
+    new OculusPreDrawCallback(camera, buffer, this, OculusTextureBuffer::ALL_LAYERS));
+
+  camera->setFinalDrawCallback(new OculusPostDrawCallback(
+    camera, buffer, this, OculusTextureBuffer::ALL_LAYERS, m_blitOnPostDraw));
+
+  // Per eye views and projections, updated every frame by the update slave callback
+  osg::ref_ptr<osg::Uniform> view =
+    new osg::Uniform(osg::Uniform::FLOAT_MAT4, "oculus_ViewMatrix", 2);
+  view->setDataVariance(osg::Object::DYNAMIC);
+  view->setElement(0, stereoViewMatrix(Eye::LEFT));
+  view->setElement(1, stereoViewMatrix(Eye::RIGHT));
+
+  osg::ref_ptr<osg::Uniform> projection =
+    new osg::Uniform(osg::Uniform::FLOAT_MAT4, "oculus_ProjectionMatrix", 2);
+  projection->setDataVariance(osg::Object::DYNAMIC);
+  projection->setElement(0, projectionMatrix(Eye::LEFT));
+  projection->setElement(1, projectionMatrix(Eye::RIGHT));
+
+  osg::StateSet* stateSet = camera->getOrCreateStateSet();
+  stateSet->addUniform(view.get());
+  stateSet->addUniform(projection.get());
+  stateSet->setAttributeAndModes(createMultiviewProgram());
+#if (OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0))
+  stateSet->setDefine("OCULUS_MULTIVIEW");
+#endif
 
   return camera.release();
 }
 
+osg::Camera* OculusDevice::setupQuadLayerCamera(OculusQuadLayer* layer,
+                                                osg::GraphicsContext* gc) {
+  osg::Camera* camera = layer->camera();
+  camera->setGraphicsContext(gc);
+
+  // Like the eye cameras, the camera draws into framebuffers bound by its draw callbacks
+  camera->setInitialDrawCallback(new OculusInitialDrawCallback());
+  camera->setPreDrawCallback(new OculusQuadLayerPreDrawCallback(layer, this));
+  camera->setFinalDrawCallback(new OculusQuadLayerPostDrawCallback(layer, this));
+
+  return camera;
+}
+
 bool OculusDevice::waitToBeginFrame(long long frameIndex) {
   ovrResult error = ovr_WaitToBeginFrame(m_session, frameIndex);
   return (error == ovrSuccess);
@@ -261,44 +916,133 @@ bool OculusDevice::waitToBeginFrame(long long frameIndex) {
 
 bool OculusDevice::beginFrame(long long frameIndex) {
   ovrResult error = ovr_BeginFrame(m_session, frameIndex);
-  m_begunFrame = (error == ovrSuccess);
+  frameData(frameIndex).begunFrame = (error == ovrSuccess);
+
   return (error == ovrSuccess);
 }
 
 bool OculusDevice::submitFrame(long long frameIndex) {
+  const OculusFrameData& frame = frameData(frameIndex);
+
+  // The next draw belongs to the following frame
+  m_drawFrameIndex = frameIndex + 1;
+
+  if (frame.frameIndex != frameIndex) {
+    osg::notify(osg::WARN) << "Warning: Frame " << frameIndex << " was overwritten by frame "
+                           << frame.frameIndex << " before it was submitted." << std::endl;
+    return false;
+  }
+
   m_layerEyeFovDepth.Header.Type = ovrLayerType_EyeFovDepth;
   m_layerEyeFovDepth.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft;  // Because OpenGL.
-  m_layerEyeFovDepth.ProjectionDesc = m_posTimewarpProjectionDesc;
-  m_layerEyeFovDepth.SensorSampleTime = m_sensorSampleTime;
+  m_layerEyeFovDepth.ProjectionDesc = frame.timewarpProjectionDesc;
+
+  // Commit the rendered images, a texture shared by both eyes is only committed once
+  const bool sharedTexture = m_textureBuffer[0] == m_textureBuffer[1];
+  m_textureBuffer[0]->commit();
+  if (!sharedTexture) {
+    m_textureBuffer[1]->commit();
+  }
 
-  if (m_begunFrame) {
+  // Quad layers are only committed when drawn, the compositor keeps showing their last image
+  for (const osg::ref_ptr<OculusQuadLayer>& layer : m_quadLayers) {
+    if (layer->drawn(frameIndex)) {
+      layer->commit(m_session);
+    }
+  }
+
+  if (frame.begunFrame) {
+    // A shared texture holds the right eye in its second layer or in its right half
     m_layerEyeFovDepth.ColorTexture[0] = m_textureBuffer[0]->colorTextureSwapChain();
-    m_layerEyeFovDepth.ColorTexture[1] = m_textureBuffer[1]->colorTextureSwapChain();
+    m_layerEyeFovDepth.ColorTexture[1] =
+      sharedTexture ? nullptr : m_textureBuffer[1]->colorTextureSwapChain();
+
+    m_layerEyeFovDepth.DepthTexture[0] = m_textureBuffer[0]->depthTextureSwapChain();
+    m_layerEyeFovDepth.DepthTexture[1] =
+      sharedTexture ? nullptr : m_textureBuffer[1]->depthTextureSwapChain();
 
-    m_layerEyeFovDepth.DepthTexture[0] = m_textureBuffer[0]->colorTextureSwapChain();
-    m_layerEyeFovDepth.DepthTexture[1] = m_textureBuffer[1]->colorTextureSwapChain();
+    // The viewports follow the dynamic resolution scale used when rendering this frame
+    m_layerEyeFovDepth.Viewport[0] = eyeViewport(Eye::LEFT, frame);
+    m_layerEyeFovDepth.Viewport[1] = eyeViewport(Eye::RIGHT, frame);
 
-    m_layerEyeFovDepth.Fov[0] = m_eyeRenderDesc[0].Fov;
-    m_layerEyeFovDepth.Fov[1] = m_eyeRenderDesc[1].Fov;
+    // Submit the poses and field of view this frame was rendered with
+    m_layerEyeFovDepth.Fov[0] = frame.eyeRenderDesc[0].Fov;
+    m_layerEyeFovDepth.Fov[1] = frame.eyeRenderDesc[1].Fov;
 
-    m_layerEyeFovDepth.RenderPose[0] = m_eyeRenderPose[0];
-    m_layerEyeFovDepth.RenderPose[1] = m_eyeRenderPose[1];
+    const ovrPosef* renderPose = frame.lateLatched ? frame.lateRenderPose : frame.eyeRenderPose;
+    m_layerEyeFovDepth.RenderPose[0] = renderPose[0];
+    m_layerEyeFovDepth.RenderPose[1] = renderPose[1];
 
-    m_layerEyeFovDepth.SensorSampleTime = m_sensorSampleTime;
+    m_layerEyeFovDepth.SensorSampleTime =
+      frame.lateLatched ? frame.lateSensorSampleTime : frame.sensorSampleTime;
+
+    // Layers are composited in order, the cube layer is drawn beneath the eye layer
+    const ovrLayerHeader* layers[ovrMaxLayerCount] = {};
+    unsigned int layerCount = 0;
+
+    if (m_cubeLayer.valid() && m_cubeLayer->layer()) {
+      layers[layerCount++] = m_cubeLayer->layer();
+    }
+
+    layers[layerCount++] = &m_layerEyeFovDepth.Header;
+
+    for (const osg::ref_ptr<OculusQuadLayer>& layer : m_quadLayers) {
+      if (const ovrLayerHeader* header = layer->layer(frameIndex)) {
+        layers[layerCount++] = header;
+      }
+    }
 
-    ovrLayerHeader* layers = &m_layerEyeFovDepth.Header;
     ovrViewScaleDesc viewScale;
-    viewScale.HmdToEyePose[0] = m_eyeRenderDesc[0].HmdToEyePose;
-    viewScale.HmdToEyePose[1] = m_eyeRenderDesc[1].HmdToEyePose;
+    viewScale.HmdToEyePose[0] = frame.eyeRenderDesc[0].HmdToEyePose;
+    viewScale.HmdToEyePose[1] = frame.eyeRenderDesc[1].HmdToEyePose;
     viewScale.HmdSpaceToWorldScaleInMeters = m_worldUnitsPerMetre;
-    ovrResult result = ovr_EndFrame(m_session, frameIndex, &viewScale, &layers, 1);
+    ovrResult result = ovr_EndFrame(m_session, frameIndex, &viewScale, layers, layerCount);
+    // Frames keep being submitted while idle, to learn when the application is visible again
+    m_endFrameNotVisible = (result == ovrSuccess_NotVisible);
     return (result == ovrSuccess);
   }
   return false;
 }
 
 void OculusDevice::blitMirrorTexture(osg::GraphicsContext* gc) const {
+  if (!m_mirrorTexture.valid()) {
+    return;
+  }
+
+  OculusGpuTimer* timer = gpuTimer();
+
+  if (timer) {
+    timer->begin(*gc->getState(), OculusGpuTimer::MIRROR_BLIT);
+  }
+
   m_mirrorTexture->blitTexture(gc);
+
+  if (timer) {
+    timer->end(*gc->getState(), OculusGpuTimer::MIRROR_BLIT);
+  }
+}
+
+void OculusDevice::captureMirrorTexture(osg::GraphicsContext* gc) const {
+  if (m_mirrorTexture.valid()) {
+    m_mirrorTexture->capture(gc);
+  }
+}
+
+OculusGpuTimer* OculusDevice::gpuTimer() const {
+  osg::ref_ptr<osg::Stats> stats;
+  if (m_stats.lock(stats) && stats->collectStats("gpu")) {
+    return m_gpuTimer.get();
+  }
+
+  return nullptr;
+}
+
+void OculusDevice::collectGpuTimes(osg::GraphicsContext* gc) {
+  if (m_gpuTimer.valid()) {
+    osg::ref_ptr<osg::Stats> stats;
+    m_stats.lock(stats);
+    m_gpuTimer->endFrame(*gc->getState(), stats.get());
+  }
 }
 
 void OculusDevice::setPerfHudMode(int mode) {
@@ -407,11 +1151,38 @@ void OculusDevice::printHMDDebugInfo() {
                            << m_hmdDesc.FirmwareMinor << std::endl;
 }
 
+osg::Matrixf OculusDevice::viewMatrix(const osg::Vec3& eyePosition,
+                                      const osg::Quat& eyeOrientation) const {
+  osg::Matrix viewMatrix;
+
+  // invert orientation (conjugate of Quaternion) and position to apply to the view matrix as offset
+  viewMatrix.setTrans(-eyePosition);
+  viewMatrix.postMultRotate(eyeOrientation.conj());
+
+  // Scale to world units
+  viewMatrix.postMultScale(
+    osg::Vec3d(m_worldUnitsPerMetre, m_worldUnitsPerMetre, m_worldUnitsPerMetre));
+
+  return viewMatrix;
+}
+
 void OculusDevice::getEyeRenderDesc() {
   m_eyeRenderDesc[0] = ovr_GetRenderDesc(m_session, ovrEye_Left, m_hmdDesc.DefaultEyeFov[0]);
   m_eyeRenderDesc[1] = ovr_GetRenderDesc(m_session, ovrEye_Right, m_hmdDesc.DefaultEyeFov[1]);
 }
 
+void OculusDevice::setupFrameData() {
+  // Frames drawn before the first update, e.g. when the cameras are created, use the head origin
+  for (OculusFrameData& frame : m_frameData) {
+    for (int eye = 0; eye < 2; ++eye) {
+      frame.eyeRenderDesc[eye] = m_eyeRenderDesc[eye];
+      frame.eyeRenderPose[eye] = m_eyeRenderDesc[eye].HmdToEyePose;
+    }
+
+    frame.viewportScale = m_viewportScale;
+  }
+}
+
 void OculusDevice::setTrackingOrigin() {
   // Set the origin for the tracking system
   // Eye level is suitable for seated/cockpit or 3rd person experiences.
@@ -427,23 +1198,76 @@ void OculusDevice::setupLayers() {
   m_layerEyeFovDepth.Header.Type = ovrLayerType_EyeFovDepth;
   m_layerEyeFovDepth.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft;  // Because OpenGL.
 
-  ovrRecti viewPort[2];
-  viewPort[0].Pos.x = 0;
-  viewPort[0].Pos.y = 0;
-  viewPort[0].Size.w = m_textureBuffer[0]->textureWidth();
-  viewPort[0].Size.h = m_textureBuffer[0]->textureHeight();
-
-  viewPort[1].Pos.x = 0;
-  viewPort[1].Pos.y = 0;
-  viewPort[1].Size.w = m_textureBuffer[1]->textureWidth();
-  viewPort[1].Size.h = m_textureBuffer[1]->textureHeight();
-
-  m_layerEyeFovDepth.Viewport[0] = viewPort[0];
-  m_layerEyeFovDepth.Viewport[1] = viewPort[1];
+  m_layerEyeFovDepth.Viewport[0] = eyeViewport(Eye::LEFT);
+  m_layerEyeFovDepth.Viewport[1] = eyeViewport(Eye::RIGHT);
   m_layerEyeFovDepth.Fov[0] = m_eyeRenderDesc[0].Fov;
   m_layerEyeFovDepth.Fov[1] = m_eyeRenderDesc[1].Fov;
 }
 
+void OculusDevice::setupHiddenAreaMeshes() {
+  if (!m_hiddenAreaMask) {
+    return;
+  }
+
+  for (int eye = 0; eye < 2; ++eye) {
+    ovrFovStencilDesc stencilDesc = {};
+    stencilDesc.StencilType = ovrFovStencil_HiddenArea;
+    stencilDesc.StencilFlags = ovrFovStencilFlag_MeshOriginAtBottomLeft;  // Because OpenGL.
+    stencilDesc.Eye = (ovrEyeType)eye;
+    stencilDesc.FovPort = m_eyeRenderDesc[eye].Fov;
+    stencilDesc.HmdToEyeRotation = m_eyeRenderDesc[eye].HmdToEyePose.Orientation;
+
+    // Query the size of the mesh before fetching it
+    ovrFovStencilMeshBuffer meshBuffer = {};
+    ovrResult result = ovr_GetFovStencil(m_session, &stencilDesc, &meshBuffer);
+
+    if (!OVR_SUCCESS(result) || meshBuffer.UsedVertexCount == 0 ||
+        meshBuffer.UsedIndexCount == 0) {
+      osg::notify(osg::WARN) << "Warning: Unable to get the hidden area mesh!" << std::endl;
+      m_hiddenAreaMesh[eye] = nullptr;
+      continue;
+    }
+
+    std::vector<ovrVector2f> vertices(meshBuffer.UsedVertexCount);
+    std::vector<uint16_t> indices(meshBuffer.UsedIndexCount);
+    meshBuffer.AllocVertexCount = meshBuffer.UsedVertexCount;
+    meshBuffer.VertexBuffer = vertices.data();
+    meshBuffer.AllocIndexCount = meshBuffer.UsedIndexCount;
+    meshBuffer.IndexBuffer = indices.data();
+    result = ovr_GetFovStencil(m_session, &stencilDesc, &meshBuffer);
+
+    if (!OVR_SUCCESS(result)) {
+      osg::notify(osg::WARN) << "Warning: Unable to get the hidden area mesh!" << std::endl;
+      m_hiddenAreaMesh[eye] = nullptr;
+      continue;
+    }
+
+    // Map the mesh from viewport coordinates to the near plane in normalized device coordinates
+    osg::ref_ptr<osg::Vec3Array> vertexArray = new osg::Vec3Array();
+    for (int i = 0; i < meshBuffer.UsedVertexCount; ++i) {
+      vertexArray->push_back(
+        osg::Vec3(vertices[i].x * 2.0f - 1.0f, vertices[i].y * 2.0f - 1.0f, -1.0f));
+    }
+
+    osg::ref_ptr<osg::DrawElementsUShort> triangles = new osg::DrawElementsUShort(
+      GL_TRIANGLES, indices.begin(), indices.begin() + meshBuffer.UsedIndexCount);
+
+    m_hiddenAreaMesh[eye] = new osg::Geometry();
+    m_hiddenAreaMesh[eye]->setUseDisplayList(false);
+    m_hiddenAreaMesh[eye]->setUseVertexBufferObjects(true);
+    m_hiddenAreaMesh[eye]->setVertexArray(vertexArray.get());
+    m_hiddenAreaMesh[eye]->addPrimitiveSet(triangles.get());
+  }
+
+  // Only write depth, and always write it
+  m_hiddenAreaStateSet = new osg::StateSet();
+  m_hiddenAreaStateSet->setAttributeAndModes(new osg::Depth(osg::Depth::ALWAYS, 0.0, 1.0, true));
+  m_hiddenAreaStateSet->setAttribute(new osg::ColorMask(false, false, false, false));
+  m_hiddenAreaStateSet->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+  m_hiddenAreaStateSet->setMode(GL_CULL_FACE, osg::StateAttribute::OFF);
+  m_hiddenAreaStateSet->setMode(GL_BLEND, osg::StateAttribute::OFF);
+}
+
 void OculusDevice::trySetProcessAsHighPriority() const {
   // Require at least 4 processors, otherwise the process could occupy the machine.
   if (OpenThreads::GetNumberOfProcessors() >= 4) {
@@ -8,7 +8,143 @@
 
 #include <oculusdevice.h>
 #include <oculusdrawcallbacks.h>
+#include <oculusgputimer.h>
+#include <oculusquadlayer.h>
 #include <oculustexturebuffer.h>
+#include <oculustrace.h>
+
+static osgUtil::RenderStage* getRenderStage(osg::RenderInfo& renderInfo) {
+  osg::Camera* camera = renderInfo.getCurrentCamera();
+  osgViewer::Renderer* camRenderer = (dynamic_cast<osgViewer::Renderer*>(camera->getRenderer()));
+
+  if (camRenderer == nullptr) {
+    return nullptr;
+  }
+
+  // Threaded viewers alternate between two scene views, use the one being drawn
+  for (unsigned int i = 0; i < 2; ++i) {
+    osgUtil::SceneView* sceneView = camRenderer->getSceneView(i);
+
+    if (sceneView != nullptr && &sceneView->getRenderInfo() == &renderInfo) {
+      return sceneView->getRenderStage();
+    }
+  }
+
+  osgUtil::SceneView* sceneView = camRenderer->getSceneView(0);
+  return sceneView != nullptr ? sceneView->getRenderStage() : nullptr;
+}
+
+static osg::RefMatrix* findProjection(osgUtil::RenderBin* bin) {
+  // All leaves culled by the camera itself share the projection matrix of the render stage
+  for (osgUtil::RenderLeaf* leaf : bin->getRenderLeafList()) {
+    if (leaf->_projection.valid()) {
+      return leaf->_projection.get();
+    }
+  }
+
+  for (osgUtil::StateGraph* stateGraph : bin->getStateGraphList()) {
+    for (const osg::ref_ptr<osgUtil::RenderLeaf>& leaf : stateGraph->_leaves) {
+      if (leaf->_projection.valid()) {
+        return leaf->_projection.get();
+      }
+    }
+  }
+
+  for (const auto& child : bin->getRenderBinList()) {
+    if (osg::RefMatrix* projection = findProjection(child.second.get())) {
+      return projection;
+    }
+  }
+
+  return nullptr;
+}
+
+static void replaceProjection(osgUtil::RenderBin* bin,
+                              const osg::RefMatrix* projection,
+                              osg::RefMatrix* replacement) {
+  for (osgUtil::RenderLeaf* leaf : bin->getRenderLeafList()) {
+    if (leaf->_projection.get() == projection) {
+      leaf->_projection = replacement;
+    }
+  }
+
+  for (osgUtil::StateGraph* stateGraph : bin->getStateGraphList()) {
+    for (const osg::ref_ptr<osgUtil::RenderLeaf>& leaf : stateGraph->_leaves) {
+      if (leaf->_projection.get() == projection) {
+        leaf->_projection = replacement;
+      }
+    }
+  }
+
+  for (const auto& child : bin->getRenderBinList()) {
+    replaceProjection(child.second.get(), projection, replacement);
+  }
+}
+
+static void setStageProjection(osg::RenderInfo& renderInfo,
+                               osgUtil::RenderStage* renderStage,
+                               const osg::Matrix& projectionMatrix) {
+  osg::ref_ptr<osg::RefMatrix> projection = findProjection(renderStage);
+
+  if (projection.valid()) {
+    // The leaves get a matrix of their own, the culled one may be shared with other stages
+    replaceProjection(renderStage, projection.get(), new osg::RefMatrix(projectionMatrix));
+    renderInfo.getState()->applyProjectionMatrix(nullptr);
+  }
+}
+
+static unsigned int countDynamicLeaves(osgUtil::RenderBin* bin) {
+  unsigned int count = 0;
+
+  for (osgUtil::RenderLeaf* leaf : bin->getRenderLeafList()) {
+    count += leaf->_dynamic ? 1 : 0;
+  }
+
+  for (osgUtil::StateGraph* stateGraph : bin->getStateGraphList()) {
+    for (const osg::ref_ptr<osgUtil::RenderLeaf>& leaf : stateGraph->_leaves) {
+      count += leaf->_dynamic ? 1 : 0;
+    }
+  }
+
+  for (const auto& child : bin->getRenderBinList()) {
+    count += countDynamicLeaves(child.second.get());
+  }
+
+  return count;
+}
+
+static void beginGpuTimer(osg::RenderInfo& renderInfo,
+                          const OculusDevice* device,
+                          OculusGpuTimer::Stage stage) {
+  if (OculusGpuTimer* timer = device->gpuTimer()) {
+    timer->begin(*renderInfo.getState(), stage);
+  }
+}
+
+static void endGpuTimer(osg::RenderInfo& renderInfo,
+                        const OculusDevice* device,
+                        OculusGpuTimer::Stage stage) {
+  if (OculusGpuTimer* timer = device->gpuTimer()) {
+    timer->end(*renderInfo.getState(), stage);
+  }
+}
+
+static const char* preDrawTraceName(int layer) {
+  static const char* const s_names[] = {"Both eyes pre draw", "Left eye pre draw",
+                                        "Right eye pre draw"};
+  return s_names[layer + 1];
+}
+
+static const char* postDrawTraceName(int layer) {
+  static const char* const s_names[] = {"Both eyes post draw", "Left eye post draw",
+                                        "Right eye post draw"};
+  return s_names[layer + 1];
+}
+
+static OculusGpuTimer::Stage eyeStage(int layer) {
+  return layer == OculusTextureBuffer::ALL_LAYERS ? OculusGpuTimer::BOTH_EYES :
+                                                    (OculusGpuTimer::Stage)layer;
+}
 
 void OculusInitialDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
   osg::GraphicsOperation* graphicsOperation = renderInfo.getCurrentCamera()->getRenderer();
@@ -20,20 +156,166 @@ void OculusInitialDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
 }
 
 void OculusPreDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
-  m_textureBuffer->onPreRender(renderInfo);
+  if (m_device->drawFrame().idle) {
+    return;
+  }
+
+  OculusTraceScope trace(preDrawTraceName(m_layer), m_device->drawFrame().frameIndex);
+  beginGpuTimer(renderInfo, m_device, eyeStage(m_layer));
+
+  // The left eye is drawn first, the right eye camera has a higher render order
+  if (m_layer != OculusDevice::Eye::RIGHT) {
+    m_device->applyRenderSamples(renderInfo);
+  }
+
+  m_textureBuffer->onPreRender(renderInfo, m_layer);
+
+  if (m_layer != OculusTextureBuffer::ALL_LAYERS) {
+    m_device->drawHiddenAreaMask(renderInfo, (OculusDevice::Eye)m_layer);
+  }
+
+  m_device->lateLatch(renderInfo, m_layer);
 }
 
 OculusPostDrawCallback::OculusPostDrawCallback(osg::Camera* camera,
                                                OculusTextureBuffer* textureBuffer,
                                                const OculusDevice* device,
+                                               int layer,
                                                bool blit) :
     m_camera(camera),
     m_textureBuffer(textureBuffer),
     m_device(device),
+    m_layer(layer),
     m_blit(blit) {}
 
 void OculusPostDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
-  m_textureBuffer->onPostRender(renderInfo);
-  if (m_blit)
+  if (m_device->drawFrame().idle) {
+    return;
+  }
+
+  OculusTraceScope trace(postDrawTraceName(m_layer), m_device->drawFrame().frameIndex);
+  endGpuTimer(renderInfo, m_device, eyeStage(m_layer));
+
+  beginGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+  m_textureBuffer->onPostRender(renderInfo, m_layer);
+  endGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+  if (m_blit && m_device->drawFrame().mirror)
+    m_device->blitMirrorTexture(m_camera->getGraphicsContext());
+}
+
+OculusStereoPreDrawCallback::OculusStereoPreDrawCallback(osg::Camera* camera,
+                                                         OculusTextureBuffer* textureBuffer,
+                                                         OculusDevice* device) :
+    m_camera(camera),
+    m_textureBuffer(textureBuffer),
+    m_device(device) {}
+
+void OculusStereoPreDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
+  if (m_device->drawFrame().idle) {
+    return;
+  }
+
+  OculusTraceScope trace("Left eye pre draw", m_device->drawFrame().frameIndex);
+  beginGpuTimer(renderInfo, m_device, OculusGpuTimer::LEFT_EYE);
+
+  m_device->applyRenderSamples(renderInfo);
+  m_textureBuffer->onPreRender(renderInfo, OculusDevice::Eye::LEFT);
+  m_device->drawHiddenAreaMask(renderInfo, OculusDevice::Eye::LEFT);
+  m_device->lateLatch(renderInfo, OculusDevice::Eye::LEFT);
+
+  osgUtil::RenderStage* renderStage = getRenderStage(renderInfo);
+  if (renderStage) {
+    setStageProjection(renderInfo,
+                       renderStage,
+                       m_device->stereoProjectionMatrix(OculusDevice::Eye::LEFT,
+                                                        m_device->drawFrame()));
+
+    // Every dynamic leaf is drawn twice and counts down the dynamic objects each time. Count them
+    // twice, so that a threaded viewer does not update the scene before the right eye is drawn.
+    osg::State& state = *renderInfo.getState();
+    state.setDynamicObjectCount(state.getDynamicObjectCount() + countDynamicLeaves(renderStage));
+  }
+}
+
+OculusStereoPostDrawCallback::OculusStereoPostDrawCallback(osg::Camera* camera,
+                                                           OculusTextureBuffer* leftTextureBuffer,
+                                                           OculusTextureBuffer* rightTextureBuffer,
+                                                           OculusDevice* device,
+                                                           bool blit) :
+    m_camera(camera),
+    m_leftTextureBuffer(leftTextureBuffer),
+    m_rightTextureBuffer(rightTextureBuffer),
+    m_device(device),
+    m_blit(blit) {}
+
+void OculusStereoPostDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
+  if (m_device->drawFrame().idle) {
+    return;
+  }
+
+  OculusTraceScope trace("Stereo post draw", m_device->drawFrame().frameIndex);
+  endGpuTimer(renderInfo, m_device, OculusGpuTimer::LEFT_EYE);
+
+  beginGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+  m_leftTextureBuffer->onPostRender(renderInfo, OculusDevice::Eye::LEFT);
+  endGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+
+  osgUtil::RenderStage* renderStage = getRenderStage(renderInfo);
+  if (renderStage) {
+    beginGpuTimer(renderInfo, m_device, OculusGpuTimer::RIGHT_EYE);
+
+    m_rightTextureBuffer->onPreRender(renderInfo, OculusDevice::Eye::RIGHT);
+    m_device->drawHiddenAreaMask(renderInfo, OculusDevice::Eye::RIGHT);
+    m_device->lateLatch(renderInfo, OculusDevice::Eye::RIGHT);
+    setStageProjection(renderInfo,
+                       renderStage,
+                       m_device->stereoProjectionMatrix(OculusDevice::Eye::RIGHT,
+                                                        m_device->drawFrame()));
+
+    // The right eye may be rendered to another region of a shared texture
+    osg::ref_ptr<osg::Viewport> leftViewport = renderStage->getViewport();
+    const ovrRecti rightViewport =
+      m_device->eyeViewport(OculusDevice::Eye::RIGHT, m_device->drawFrame());
+    renderStage->setViewport(new osg::Viewport(
+      rightViewport.Pos.x, rightViewport.Pos.y, rightViewport.Size.w, rightViewport.Size.h));
+
+    // Replay the render graph from the left eye, starting from a clean state stack
+    osg::State& state = *renderInfo.getState();
+    state.popAllStateSets();
+    state.apply();
+
+    osgUtil::RenderLeaf* previous = nullptr;
+    renderStage->drawImplementation(renderInfo, previous);
+
+    state.popAllStateSets();
+    state.apply();
+
+    renderStage->setViewport(leftViewport.get());
+
+    endGpuTimer(renderInfo, m_device, OculusGpuTimer::RIGHT_EYE);
+
+    beginGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+    m_rightTextureBuffer->onPostRender(renderInfo, OculusDevice::Eye::RIGHT);
+    endGpuTimer(renderInfo, m_device, OculusGpuTimer::MSAA_RESOLVE);
+  }
+
+  if (m_blit && m_device->drawFrame().mirror)
     m_device->blitMirrorTexture(m_camera->getGraphicsContext());
-}
\ No newline at end of file
+}
+
+void OculusQuadLayerPreDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
+  if (!m_layer.valid() || !m_layer->drawn(m_device->drawFrame().frameIndex)) {
+    return;
+  }
+
+  OculusTraceScope trace("Quad layer pre draw", m_device->drawFrame().frameIndex);
+  m_layer->onPreRender(renderInfo, m_device->session());
+}
+
+void OculusQuadLayerPostDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
+  if (!m_layer.valid() || !m_layer->drawn(m_device->drawFrame().frameIndex)) {
+    return;
+  }
+
+  m_layer->onPostRender(renderInfo);
+}
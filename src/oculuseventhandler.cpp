@@ -7,6 +7,7 @@
 
 #include <oculusdevice.h>
 #include <oculuseventhandler.h>
+#include <oculustrace.h>
 
 bool OculusEventHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& ad) {
   switch (ea.getEventType()) {
@@ -17,6 +18,13 @@ bool OculusEventHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActi
           return osgGA::GUIEventHandler::handle(ea, ad);
           break;
 
+        case osgGA::GUIEventAdapter::KEY_T:
+          if (OculusTrace::enabled()) {
+            OculusTrace::write();
+          }
+          return osgGA::GUIEventHandler::handle(ea, ad);
+          break;
+
         case osgGA::GUIEventAdapter::KEY_0:
           m_oculusDevice->setPerfHudMode(0);
           return osgGA::GUIEventHandler::handle(ea, ad);
@@ -0,0 +1,142 @@
+/*
+ * oculusgputimer.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <glextensions.h>
+#include <oculusgputimer.h>
+
+OculusGpuTimer::OculusGpuTimer(const osg::State& state) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  for (Frame& frame : m_frames) {
+    ext->glGenQueries(STAGE_COUNT * MAX_SPANS * 2, &frame.queries[0][0][0]);
+
+    for (int& spanCount : frame.spanCount) {
+      spanCount = 0;
+    }
+
+    frame.lastQuery = 0;
+    frame.frameNumber = 0;
+    frame.pending = false;
+  }
+}
+
+void OculusGpuTimer::destroy(const osg::State& state) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  for (Frame& frame : m_frames) {
+    ext->glDeleteQueries(STAGE_COUNT * MAX_SPANS * 2, &frame.queries[0][0][0]);
+    frame.pending = false;
+  }
+}
+
+void OculusGpuTimer::begin(const osg::State& state, Stage stage) {
+  Frame& frame = m_frames[m_currentFrame];
+
+  // Skip the measurement rather than reuse queries the GPU has not finished yet
+  if (frame.pending || frame.spanCount[stage] >= MAX_SPANS) {
+    return;
+  }
+
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  ext->glQueryCounter(frame.queries[stage][frame.spanCount[stage]][0], GL_TIMESTAMP);
+  m_open[stage] = true;
+}
+
+void OculusGpuTimer::end(const osg::State& state, Stage stage) {
+  if (!m_open[stage]) {
+    return;
+  }
+
+  Frame& frame = m_frames[m_currentFrame];
+  const GLuint query = frame.queries[stage][frame.spanCount[stage]][1];
+
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  ext->glQueryCounter(query, GL_TIMESTAMP);
+  frame.lastQuery = query;
+  ++frame.spanCount[stage];
+  m_open[stage] = false;
+}
+
+void OculusGpuTimer::endFrame(const osg::State& state, osg::Stats* stats) {
+  Frame& current = m_frames[m_currentFrame];
+
+  if (!current.pending && current.lastQuery != 0) {
+    const osg::FrameStamp* frameStamp = state.getFrameStamp();
+    current.frameNumber = frameStamp ? frameStamp->getFrameNumber() : 0;
+    current.pending = true;
+    m_currentFrame = (m_currentFrame + 1) % FRAME_COUNT;
+  }
+
+  for (bool& open : m_open) {
+    open = false;
+  }
+
+  // Read the finished frames from the oldest, stopping at the first the GPU is still working on
+  for (int i = 0; i < FRAME_COUNT; ++i) {
+    Frame& frame = m_frames[(m_currentFrame + i) % FRAME_COUNT];
+
+    if (frame.pending && !readFrame(state, frame, stats)) {
+      break;
+    }
+  }
+}
+
+bool OculusGpuTimer::readFrame(const osg::State& state, Frame& frame, osg::Stats* stats) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  // Timestamps complete in order, so all queries are available when the last one is
+  GLint available = 0;
+  ext->glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+  if (!available) {
+    return false;
+  }
+
+  for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+    if (frame.spanCount[stage] == 0) {
+      continue;
+    }
+
+    GLuint64 elapsed = 0;
+    for (int span = 0; span < frame.spanCount[stage]; ++span) {
+      GLuint64 beginTime = 0;
+      GLuint64 endTime = 0;
+      ext->glGetQueryObjectui64v(frame.queries[stage][span][0], GL_QUERY_RESULT, &beginTime);
+      ext->glGetQueryObjectui64v(frame.queries[stage][span][1], GL_QUERY_RESULT, &endTime);
+      elapsed += endTime > beginTime ? endTime - beginTime : 0;
+    }
+
+    m_lastTime[stage] = elapsed * 1.0e-9;
+
+    if (stats) {
+      stats->setAttribute(frame.frameNumber, attributeName((Stage)stage), m_lastTime[stage]);
+    }
+
+    frame.spanCount[stage] = 0;
+  }
+
+  frame.lastQuery = 0;
+  frame.pending = false;
+  return true;
+}
+
+const char* OculusGpuTimer::attributeName(Stage stage) {
+  switch (stage) {
+    case LEFT_EYE:
+      return "Left eye GPU time taken";
+    case RIGHT_EYE:
+      return "Right eye GPU time taken";
+    case BOTH_EYES:
+      return "Both eyes GPU time taken";
+    case MSAA_RESOLVE:
+      return "MSAA resolve GPU time taken";
+    case MIRROR_BLIT:
+      return "Mirror blit GPU time taken";
+    default:
+      return "";
+  }
+}
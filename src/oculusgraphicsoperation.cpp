@@ -10,6 +10,7 @@
 
 #include <oculusdevice.h>
 #include <oculusgraphicsoperation.h>
+#include <oculusviewer.h>
 
 void OculusRealizeOperation::operator()(osg::GraphicsContext* gc) {
   if (!m_realized) {
@@ -26,6 +27,12 @@ void OculusRealizeOperation::operator()(osg::GraphicsContext* gc) {
 
     // Init the oculus system
     m_device->init();
+
+    // Add the eye cameras while the viewer is still being realized, before its threads start
+    osg::ref_ptr<OculusViewer> viewer;
+    if (m_viewer.lock(viewer)) {
+      viewer->configure();
+    }
   }
 
   m_realized = true;
@@ -0,0 +1,71 @@
+/*
+ * oculuslatelatch.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <cstring>
+
+#include <glextensions.h>
+#include <oculuslatelatch.h>
+
+// Size of the uniform block, two std140 mat4
+static const GLsizeiptr s_blockSize = 2 * 16 * sizeof(GLfloat);
+
+OculusLateLatch::OculusLateLatch(const osg::State& state) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  // Every bound range must start at a multiple of the offset alignment
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  m_stride = ((s_blockSize + alignment - 1) / alignment) * alignment;
+
+  const GLsizeiptr size = m_stride * FRAME_COUNT * SLOT_COUNT;
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  ext->glGenBuffers(1, &m_buffer);
+  ext->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  ext->glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+  m_data = static_cast<unsigned char*>(ext->glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+  ext->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  if (m_data == nullptr) {
+    osg::notify(osg::WARN) << "Warning: Unable to map the late latch uniform buffer." << std::endl;
+  }
+}
+
+void OculusLateLatch::destroy(const osg::State& state) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  if (m_data != nullptr) {
+    ext->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    ext->glUnmapBuffer(GL_UNIFORM_BUFFER);
+    ext->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_data = nullptr;
+  }
+
+  if (m_buffer != 0) {
+    ext->glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+  }
+}
+
+void OculusLateLatch::apply(const osg::State& state,
+                            long long frameIndex,
+                            int slot,
+                            const osg::Matrixf& left,
+                            const osg::Matrixf& right) {
+  if (m_data == nullptr) {
+    return;
+  }
+
+  // The buffer is coherent, so the writes are seen by the draw calls issued after them. A region
+  // is rewritten FRAME_COUNT frames later, when the compositor has long consumed that frame.
+  const GLintptr offset = ((frameIndex % FRAME_COUNT) * SLOT_COUNT + slot) * m_stride;
+  std::memcpy(m_data + offset, left.ptr(), s_blockSize / 2);
+  std::memcpy(m_data + offset + s_blockSize / 2, right.ptr(), s_blockSize / 2);
+
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  ext->glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_BINDING, m_buffer, offset, s_blockSize);
+}
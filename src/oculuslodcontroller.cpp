@@ -0,0 +1,76 @@
+/*
+ * oculuslodcontroller.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <oculusdevice.h>
+#include <oculuslodcontroller.h>
+
+// Number of steps between full and lowest detail
+static const int s_levelCount = 8;
+// Part of the frame budget the GPU should use, when only the GPU time is known
+static const double s_targetUtilization = 0.9;
+// Performance scale below which the detail is lowered, and above which it is raised again
+static const double s_lowerScale = 1.0;
+static const double s_raiseScale = 1.3;
+// Compositor headroom in seconds below which the frame counts as over budget
+static const double s_minCompositorHeadroom = 0.001;
+// Number of frames a load must last before the detail is changed, raising it waits longer
+static const int s_lowerFrames = 5;
+static const int s_raiseFrames = 90;
+
+OculusLODController::OculusLODController(float maxLODScale,
+                                         float minPixelSize,
+                                         float maxPixelSize) :
+    m_maxLODScale(maxLODScale),
+    m_minPixelSize(minPixelSize),
+    m_maxPixelSize(maxPixelSize) {}
+
+void OculusLODController::update(const OculusPerformanceStats& stats, double frameBudget) {
+  if (stats.frameIndex == m_lastFrameIndex) {
+    // No frame has been completed by the compositor since the last update
+    return;
+  }
+
+  // The scale of the GPU work needed to hit the frame budget, where 1.0 is on target
+  double performanceScale = stats.adaptiveGpuPerformanceScale;
+
+  if (performanceScale <= 0.0) {
+    if (stats.appGpuElapsedTime <= 0.0f) {
+      return;
+    }
+
+    performanceScale = frameBudget * s_targetUtilization / stats.appGpuElapsedTime;
+  }
+
+  const bool dropped = stats.appDroppedFrameCount > m_droppedFrameCount;
+  m_lastFrameIndex = stats.frameIndex;
+  m_droppedFrameCount = stats.appDroppedFrameCount;
+
+  // The compositor headroom is zero when not reported
+  const bool noHeadroom =
+    stats.compositorHeadroom != 0.0f && stats.compositorHeadroom < s_minCompositorHeadroom;
+  const bool overloaded = dropped || noHeadroom || performanceScale < s_lowerScale;
+  const bool underloaded = !overloaded && performanceScale > s_raiseScale;
+
+  m_overloadedFrames = overloaded ? m_overloadedFrames + 1 : 0;
+  m_underloadedFrames = underloaded ? m_underloadedFrames + 1 : 0;
+
+  if (m_overloadedFrames >= s_lowerFrames && m_level < s_levelCount) {
+    ++m_level;
+    m_overloadedFrames = 0;
+  } else if (m_underloadedFrames >= s_raiseFrames && m_level > 0) {
+    --m_level;
+    m_underloadedFrames = 0;
+  }
+}
+
+float OculusLODController::lodScale() const {
+  return 1.0f + (m_maxLODScale - 1.0f) * m_level / s_levelCount;
+}
+
+float OculusLODController::smallFeatureCullingPixelSize() const {
+  return m_minPixelSize + (m_maxPixelSize - m_minPixelSize) * m_level / s_levelCount;
+}
@@ -0,0 +1,266 @@
+/*
+ * oculusmirrorcapture.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <osg/Notify>
+
+#include <algorithm>
+
+#include <glextensions.h>
+#include <oculusmirrorcapture.h>
+
+// Time to wait for each outstanding readback when the capture is destroyed, in nanoseconds
+static const GLuint64 s_flushTimeout = 1000000000;
+
+static unsigned char clampByte(int value) {
+  return (unsigned char)std::min(std::max(value, 0), 255);
+}
+
+OculusMirrorCapture::OculusMirrorCapture(const std::string& fileName,
+                                         Format format,
+                                         int frameRate) :
+    m_fileName(fileName),
+    m_format(format),
+    m_frameRate(frameRate) {}
+
+OculusMirrorCapture::~OculusMirrorCapture() {
+  stop();
+}
+
+void OculusMirrorCapture::setup(const osg::State& state, int width, int height) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  if (!ext->isAsyncReadbackSupported) {
+    osg::notify(osg::WARN) << "Warning: Persistently mapped buffers or fences not supported, "
+                           << "mirror capture disabled." << std::endl;
+    m_failed = true;
+    return;
+  }
+
+  m_file.open(m_fileName.c_str(), std::ios::out | std::ios::binary);
+
+  if (!m_file) {
+    osg::notify(osg::WARN) << "Warning: Unable to open " << m_fileName << " for mirror capture."
+                           << std::endl;
+    m_failed = true;
+    return;
+  }
+
+  m_width = width;
+  m_height = height;
+  m_frameSize = (GLsizeiptr)width * height * 4;
+
+  const GLsizeiptr size = m_frameSize * BUFFER_COUNT;
+  const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  ext->glGenBuffers(1, &m_buffer);
+  ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+  ext->glBufferStorage(GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+  m_data = static_cast<unsigned char*>(ext->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags));
+  ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (m_data == nullptr) {
+    osg::notify(osg::WARN) << "Warning: Unable to map the mirror capture buffer." << std::endl;
+    m_failed = true;
+    return;
+  }
+
+  if (m_format == Y4M) {
+    // Chroma at full resolution, so that the writer thread needs no filtering
+    m_file << "YUV4MPEG2 W" << width << " H" << height << " F" << m_frameRate
+           << ":1 Ip A1:1 C444\n";
+  }
+
+  m_row.resize(width * 3);
+  m_thread = std::thread(&OculusMirrorCapture::run, this);
+}
+
+void OculusMirrorCapture::capture(const osg::State& state,
+                                  GLuint readFramebuffer,
+                                  int width,
+                                  int height) {
+  if (m_failed) {
+    return;
+  }
+
+  if (m_data == nullptr) {
+    setup(state, width, height);
+
+    if (m_failed) {
+      return;
+    }
+  }
+
+  // Hand over the readbacks the GPU has finished, without waiting for the others
+  retire(state, 0);
+
+  if (m_slotState[m_nextSlot] != FREE) {
+    // The writer thread or the GPU is behind, drop the frame rather than wait
+    ++m_droppedFrames;
+    return;
+  }
+
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+
+  // The mirror texture holds the top row first, which is the row order of both file formats
+  fbo_ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, readFramebuffer);
+  ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0,
+               0,
+               std::min(width, m_width),
+               std::min(height, m_height),
+               GL_RGBA,
+               GL_UNSIGNED_BYTE,
+               (void*)(m_nextSlot * m_frameSize));
+  ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  fbo_ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, 0);
+
+  m_fences[m_nextSlot] = ext->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_slotState[m_nextSlot] = READING;
+  m_nextSlot = (m_nextSlot + 1) % BUFFER_COUNT;
+}
+
+void OculusMirrorCapture::retire(const osg::State& state, GLuint64 timeout) {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  // Readbacks finish in the order they were issued
+  while (m_slotState[m_retireSlot] == READING) {
+    const GLenum result =
+      ext->glClientWaitSync(m_fences[m_retireSlot], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      return;
+    }
+
+    ext->glDeleteSync(m_fences[m_retireSlot]);
+    m_fences[m_retireSlot] = nullptr;
+    m_slotState[m_retireSlot] = WRITING;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back(m_retireSlot);
+    }
+
+    m_condition.notify_one();
+    m_retireSlot = (m_retireSlot + 1) % BUFFER_COUNT;
+  }
+}
+
+void OculusMirrorCapture::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (true) {
+    m_condition.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+
+    if (m_queue.empty()) {
+      return;
+    }
+
+    const int slot = m_queue.front();
+    m_queue.pop_front();
+    lock.unlock();
+
+    // The buffer is coherent and its fence has signaled, so the pixels can be read directly
+    writeFrame(m_data + slot * m_frameSize);
+    m_slotState[slot] = FREE;
+    ++m_capturedFrames;
+
+    lock.lock();
+  }
+}
+
+void OculusMirrorCapture::writeFrame(const unsigned char* pixels) {
+  if (m_format == RAW_RGB) {
+    for (int y = 0; y < m_height; ++y) {
+      const unsigned char* rgba = pixels + y * m_width * 4;
+
+      for (int x = 0; x < m_width; ++x) {
+        m_row[x * 3 + 0] = rgba[x * 4 + 0];
+        m_row[x * 3 + 1] = rgba[x * 4 + 1];
+        m_row[x * 3 + 2] = rgba[x * 4 + 2];
+      }
+
+      m_file.write(reinterpret_cast<const char*>(m_row.data()), m_width * 3);
+    }
+
+    return;
+  }
+
+  // One plane after the other, converted with the BT.601 video range matrix
+  m_file << "FRAME\n";
+
+  for (int plane = 0; plane < 3; ++plane) {
+    for (int y = 0; y < m_height; ++y) {
+      const unsigned char* rgba = pixels + y * m_width * 4;
+
+      for (int x = 0; x < m_width; ++x) {
+        const int r = rgba[x * 4 + 0];
+        const int g = rgba[x * 4 + 1];
+        const int b = rgba[x * 4 + 2];
+
+        if (plane == 0) {
+          m_row[x] = clampByte(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        } else if (plane == 1) {
+          m_row[x] = clampByte(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        } else {
+          m_row[x] = clampByte(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+      }
+
+      m_file.write(reinterpret_cast<const char*>(m_row.data()), m_width);
+    }
+  }
+}
+
+void OculusMirrorCapture::stop() {
+  if (!m_thread.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+
+  // The writer thread empties the queue before it returns
+  m_condition.notify_all();
+  m_thread.join();
+}
+
+void OculusMirrorCapture::destroy(const osg::State& state) {
+  if (m_data != nullptr) {
+    // Wait for the frames still being read back, so that the recording is complete
+    retire(state, s_flushTimeout);
+  }
+
+  stop();
+
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+  for (GLsync& fence : m_fences) {
+    if (fence != nullptr) {
+      ext->glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  if (m_data != nullptr) {
+    ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+    ext->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    ext->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_data = nullptr;
+  }
+
+  if (m_buffer != 0) {
+    ext->glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+  }
+
+  m_file.close();
+  m_failed = true;
+}
@@ -9,12 +9,15 @@
 #include <osg/FrameBufferObject>
 
 #include <glextensions.h>
+#include <oculusmirrorcapture.h>
 #include <oculusmirrortexture.h>
 
 OculusMirrorTexture::OculusMirrorTexture(ovrSession& session,
                                          osg::ref_ptr<osg::State> state,
                                          int width,
-                                         int height) :
+                                         int height,
+                                         ovrTextureFormat format,
+                                         unsigned int mirrorOptions) :
     m_session(session),
     m_mirrorTexture(nullptr),
     m_width(width),
@@ -23,10 +26,18 @@ OculusMirrorTexture::OculusMirrorTexture(ovrSession& session,
   memset(&desc, 0, sizeof(desc));
   desc.Width = width;
   desc.Height = height;
-  desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+  desc.Format = format;
+  desc.MirrorOptions = mirrorOptions;
 
   // Create mirror texture and an FBO used to copy mirror texture to back buffer
   ovrResult result = ovr_CreateMirrorTextureWithOptionsGL(session, &desc, &m_mirrorTexture);
+  if (!OVR_SUCCESS(result) && format != OVR_FORMAT_R8G8B8A8_UNORM_SRGB) {
+    osg::notify(osg::WARN) << "Warning: Mirror texture format " << format
+                           << " not supported, falling back to sRGB." << std::endl;
+    desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+    result = ovr_CreateMirrorTextureWithOptionsGL(session, &desc, &m_mirrorTexture);
+  }
+
   if (!OVR_SUCCESS(result)) {
     osg::notify(osg::DEBUG_INFO) << "Failed to create mirror texture." << std::endl;
   }
@@ -60,7 +71,21 @@ void OculusMirrorTexture::blitTexture(osg::GraphicsContext* gc) const {
   fbo_ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, 0);
 }
 
+void OculusMirrorTexture::setCapture(OculusMirrorCapture* capture) {
+  m_capture = capture;
+}
+
+void OculusMirrorTexture::capture(osg::GraphicsContext* gc) const {
+  if (m_capture.valid()) {
+    m_capture->capture(*(gc->getState()), m_mirrorFBO, m_width, m_height);
+  }
+}
+
 void OculusMirrorTexture::destroy(osg::GraphicsContext* gc) {
+  if (m_capture.valid() && gc) {
+    m_capture->destroy(*(gc->getState()));
+  }
+
   if (gc) {
     const OSG_GLExtensions* fbo_ext = getGLExtensions(*(gc->getState()));
     fbo_ext->glDeleteFramebuffers(1, &m_mirrorFBO);
@@ -0,0 +1,153 @@
+/*
+ * oculusposestream.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <osg/Notify>
+
+#include <cstdint>
+#include <cstring>
+
+#include <oculusposestream.h>
+
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+// File header, the size of a sample follows the magic to reject streams of other builds. The
+// header is padded to keep the samples, which hold doubles, aligned in the mapped file.
+static const char s_magic[8] = {'O', 'V', 'R', 'P', 'O', 'S', 'E', '1'};
+static const size_t s_headerSize = 16;
+
+OculusPoseStream::OculusPoseStream(const std::string& fileName, Mode mode) : m_mode(mode) {
+  if (mode == REPLAY) {
+    map(fileName);
+    return;
+  }
+
+  m_file.open(fileName.c_str(), std::ios::out | std::ios::binary);
+
+  if (!m_file) {
+    osg::notify(osg::WARN) << "Warning: Unable to open " << fileName << " for recording poses."
+                           << std::endl;
+    return;
+  }
+
+  const uint32_t header[2] = {sizeof(OculusPoseSample), 0};
+  m_file.write(s_magic, sizeof(s_magic));
+  m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+OculusPoseStream::~OculusPoseStream() {
+  unmap();
+}
+
+void OculusPoseStream::write(const OculusPoseSample& sample) {
+  if (m_mode != RECORD || !m_file) {
+    return;
+  }
+
+  m_file.write(reinterpret_cast<const char*>(&sample), sizeof(sample));
+  ++m_sampleCount;
+}
+
+const OculusPoseSample& OculusPoseStream::read() {
+  const OculusPoseSample& sample = m_samples[m_nextSample];
+  m_nextSample = (m_nextSample + 1) % m_sampleCount;
+  return sample;
+}
+
+void OculusPoseStream::map(const std::string& fileName) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(),
+                            GENERIC_READ,
+                            FILE_SHARE_READ,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+
+  if (file != INVALID_HANDLE_VALUE) {
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+
+    if (mapping) {
+      // The view keeps the file mapped after the handles are closed
+      m_mapping = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      m_mappingSize = m_mapping ? (size_t)size.QuadPart : 0;
+      CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+  }
+#else
+  const int file = open(fileName.c_str(), O_RDONLY);
+
+  if (file >= 0) {
+    struct stat status;
+
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+      void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+      if (data != MAP_FAILED) {
+        m_mapping = static_cast<const unsigned char*>(data);
+        m_mappingSize = status.st_size;
+      }
+    }
+
+    // The mapping stays valid after the file is closed
+    close(file);
+  }
+#endif
+
+  if (m_mapping == nullptr) {
+    osg::notify(osg::WARN) << "Warning: Unable to open " << fileName << " for replaying poses."
+                           << std::endl;
+    return;
+  }
+
+  uint32_t sampleSize = 0;
+  if (m_mappingSize >= s_headerSize) {
+    std::memcpy(&sampleSize, m_mapping + sizeof(s_magic), sizeof(sampleSize));
+  }
+
+  if (m_mappingSize < s_headerSize + sizeof(OculusPoseSample) ||
+      std::memcmp(m_mapping, s_magic, sizeof(s_magic)) != 0 ||
+      sampleSize != sizeof(OculusPoseSample)) {
+    osg::notify(osg::WARN) << "Warning: " << fileName << " is not a pose stream of this build."
+                           << std::endl;
+    unmap();
+    return;
+  }
+
+  m_samples = reinterpret_cast<const OculusPoseSample*>(m_mapping + s_headerSize);
+  m_sampleCount = (unsigned int)((m_mappingSize - s_headerSize) / sizeof(OculusPoseSample));
+}
+
+void OculusPoseStream::unmap() {
+  if (m_mapping == nullptr) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(m_mapping);
+#else
+  munmap(const_cast<unsigned char*>(m_mapping), m_mappingSize);
+#endif
+
+  m_mapping = nullptr;
+  m_mappingSize = 0;
+  m_samples = nullptr;
+  m_sampleCount = 0;
+}
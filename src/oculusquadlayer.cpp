@@ -0,0 +1,193 @@
+/*
+ * oculusquadlayer.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <glextensions.h>
+#include <oculusquadlayer.h>
+
+OculusQuadLayer::OculusQuadLayer(osg::Node* subgraph, int width, int height) :
+    m_camera(new osg::Camera()),
+    m_textureWidth(width),
+    m_textureHeight(height) {
+  m_camera->setName("QuadLayerRTT");
+  m_camera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+  m_camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+  m_camera->setRenderOrder(osg::Camera::PRE_RENDER, 2);
+  m_camera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+  m_camera->setAllowEventFocus(false);
+  m_camera->setViewport(0, 0, width, height);
+  m_camera->setProjectionMatrixAsOrtho2D(0.0, width, 0.0, height);
+  m_camera->setViewMatrix(osg::Matrix::identity());
+  m_camera->addChild(subgraph);
+
+  for (ovrLayerQuad& layer : m_frameLayers) {
+    layer = {};
+  }
+}
+
+bool OculusQuadLayer::update(long long frameIndex, bool idle) {
+  const bool intervalElapsed =
+    m_updateInterval != 0 && frameIndex - m_lastUpdateFrame >= m_updateInterval;
+  const bool draw =
+    !idle && m_visible && (intervalElapsed || m_updateRequested.exchange(false));
+
+  if (draw) {
+    m_lastUpdateFrame = frameIndex;
+  }
+
+  // Skipped frames cull nothing and clear nothing, the draw callbacks leave the swap chain alone
+  m_camera->setCullMask(draw ? ~0u : 0u);
+  m_camera->setClearMask(draw ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : 0);
+
+  const int slot = frameIndex & (FRAME_COUNT - 1);
+  ovrLayerQuad& layer = m_frameLayers[slot];
+  layer.Header.Type = ovrLayerType_Quad;
+  layer.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft;  // Because OpenGL.
+  if (m_headLocked) {
+    layer.Header.Flags |= ovrLayerFlag_HeadLocked;
+  }
+  layer.Viewport.Pos.x = 0;
+  layer.Viewport.Pos.y = 0;
+  layer.Viewport.Size.w = m_textureWidth;
+  layer.Viewport.Size.h = m_textureHeight;
+  layer.QuadPoseCenter.Position.x = m_position.x();
+  layer.QuadPoseCenter.Position.y = m_position.y();
+  layer.QuadPoseCenter.Position.z = m_position.z();
+  layer.QuadPoseCenter.Orientation.x = m_orientation.x();
+  layer.QuadPoseCenter.Orientation.y = m_orientation.y();
+  layer.QuadPoseCenter.Orientation.z = m_orientation.z();
+  layer.QuadPoseCenter.Orientation.w = m_orientation.w();
+  layer.QuadSize.x = m_width;
+  layer.QuadSize.y = m_height;
+  m_frameVisible[slot] = m_visible;
+  m_frameDrawn[slot] = draw;
+
+  return draw;
+}
+
+const ovrLayerHeader* OculusQuadLayer::layer(long long frameIndex) const {
+  const int slot = frameIndex & (FRAME_COUNT - 1);
+
+  if (!m_frameVisible[slot] || !m_hasContent) {
+    return nullptr;
+  }
+
+  return &m_frameLayers[slot].Header;
+}
+
+void OculusQuadLayer::setup(const osg::State& state, ovrSession session) {
+  ovrTextureSwapChainDesc desc = {};
+  desc.Type = ovrTexture_2D;
+  desc.ArraySize = 1;
+  desc.Width = m_textureWidth;
+  desc.Height = m_textureHeight;
+  desc.MipLevels = 1;
+  desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+  desc.SampleCount = 1;
+  desc.StaticImage = ovrFalse;
+
+  ovrResult result = ovr_CreateTextureSwapChainGL(session, &desc, &m_swapChain);
+
+  if (!OVR_SUCCESS(result)) {
+    osg::notify(osg::WARN) << "Warning: Unable to create quad layer swap texture set!"
+                           << std::endl;
+    m_swapChain = nullptr;
+    m_failed = true;
+    return;
+  }
+
+  // Set once, the update only fills in the placement of the layers
+  for (ovrLayerQuad& layer : m_frameLayers) {
+    layer.ColorTexture = m_swapChain;
+  }
+
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+
+  // The depth is only needed while drawing, so all images share one renderbuffer
+  fbo_ext->glGenRenderbuffers(1, &m_depthBuffer);
+  fbo_ext->glBindRenderbuffer(GL_RENDERBUFFER_EXT, m_depthBuffer);
+  fbo_ext->glRenderbufferStorage(GL_RENDERBUFFER_EXT,
+                                 GL_DEPTH_COMPONENT24,
+                                 m_textureWidth,
+                                 m_textureHeight);
+  fbo_ext->glBindRenderbuffer(GL_RENDERBUFFER_EXT, 0);
+
+  int length = 0;
+  ovr_GetTextureSwapChainLength(session, m_swapChain, &length);
+  m_framebuffers.resize(length, 0);
+  fbo_ext->glGenFramebuffers(length, m_framebuffers.data());
+
+  for (int i = 0; i < length; ++i) {
+    GLuint texId = 0;
+    ovr_GetTextureSwapChainBufferGL(session, m_swapChain, i, &texId);
+
+    fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, m_framebuffers[i]);
+    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
+                                    GL_COLOR_ATTACHMENT0_EXT,
+                                    GL_TEXTURE_2D,
+                                    texId,
+                                    0);
+    fbo_ext->glFramebufferRenderbuffer(GL_FRAMEBUFFER_EXT,
+                                       GL_DEPTH_ATTACHMENT_EXT,
+                                       GL_RENDERBUFFER_EXT,
+                                       m_depthBuffer);
+  }
+
+  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+  ovr_GetTextureSwapChainCurrentIndex(session, m_swapChain, &m_imageIndex);
+}
+
+void OculusQuadLayer::onPreRender(osg::RenderInfo& renderInfo, ovrSession session) {
+  const osg::State& state = *renderInfo.getState();
+
+  // Created on first use, since the swap chain needs the graphics context
+  if (m_swapChain == nullptr && !m_failed) {
+    setup(state, session);
+  }
+
+  if (!m_framebuffers.empty()) {
+    getGLExtensions(state)->glBindFramebuffer(GL_FRAMEBUFFER_EXT, m_framebuffers[m_imageIndex]);
+  }
+}
+
+void OculusQuadLayer::onPostRender(osg::RenderInfo& renderInfo) {
+  getGLExtensions(*renderInfo.getState())->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+}
+
+void OculusQuadLayer::commit(ovrSession session) {
+  if (m_swapChain) {
+    ovr_CommitTextureSwapChain(session, m_swapChain);
+    ovr_GetTextureSwapChainCurrentIndex(session, m_swapChain, &m_imageIndex);
+    m_hasContent = true;
+  }
+}
+
+void OculusQuadLayer::destroy(ovrSession session, osg::GraphicsContext* gc) {
+  if (m_swapChain) {
+    ovr_DestroyTextureSwapChain(session, m_swapChain);
+    m_swapChain = nullptr;
+  }
+
+  for (ovrLayerQuad& layer : m_frameLayers) {
+    layer.ColorTexture = nullptr;
+  }
+
+  if (gc) {
+    const OSG_GLExtensions* fbo_ext = getGLExtensions(*gc->getState());
+
+    if (!m_framebuffers.empty()) {
+      fbo_ext->glDeleteFramebuffers((GLsizei)m_framebuffers.size(), m_framebuffers.data());
+      m_framebuffers.clear();
+    }
+
+    if (m_depthBuffer) {
+      fbo_ext->glDeleteRenderbuffers(1, &m_depthBuffer);
+      m_depthBuffer = 0;
+    }
+  }
+
+  m_hasContent = false;
+}
@@ -0,0 +1,93 @@
+/*
+ * oculusresolutiongovernor.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <osg/Math>
+
+#include <algorithm>
+#include <cmath>
+
+#include <oculusresolutiongovernor.h>
+
+// Part of the frame budget the GPU should use, when only the GPU time is known
+static const double s_targetUtilization = 0.9;
+// Fraction of the remaining error corrected each frame, lowering the scale reacts faster
+static const float s_decreaseGain = 0.5f;
+static const float s_increaseGain = 0.1f;
+// Smaller changes are ignored, to avoid resizing the viewports every frame
+static const float s_minStep = 0.01f;
+// Performance scale needed before the number of samples is raised again
+static const double s_headroomScale = 1.3;
+// Number of frames a load must last before the number of samples is changed
+static const int s_sustainedFrames = 90;
+
+OculusResolutionGovernor::OculusResolutionGovernor(float minScale, float maxScale, int maxSamples) :
+    m_minScale(minScale),
+    m_maxScale(maxScale),
+    m_maxSamples(maxSamples),
+    m_scale(maxScale),
+    m_samples(maxSamples) {}
+
+void OculusResolutionGovernor::update(const ovrPerfStats& stats, double frameBudget) {
+  if (stats.FrameStatsCount == 0) {
+    // No frame has been completed by the compositor since the last update
+    return;
+  }
+
+  // The scale of the GPU work needed to hit the frame budget, where 1.0 is on target
+  double performanceScale = stats.AdaptiveGpuPerformanceScale;
+
+  if (performanceScale <= 0.0) {
+    const float gpuTime = stats.FrameStats[0].AppGpuElapsedTime;
+
+    if (gpuTime <= 0.0f) {
+      return;
+    }
+
+    performanceScale = frameBudget * s_targetUtilization / gpuTime;
+  }
+
+  // The performance scale is proportional to the number of pixels, while the viewport scale is
+  // applied to both the width and the height.
+  const float target =
+    osg::clampBetween(m_scale * (float)std::sqrt(performanceScale), m_minScale, m_maxScale);
+  const float gain = target < m_scale ? s_decreaseGain : s_increaseGain;
+  const float scale = m_scale + (target - m_scale) * gain;
+
+  if (std::fabs(scale - m_scale) >= s_minStep) {
+    m_scale = scale;
+  } else if (target == m_minScale || target == m_maxScale) {
+    // Settle on the limits instead of approaching them forever
+    m_scale = target;
+  }
+
+  updateSamples(performanceScale);
+}
+
+void OculusResolutionGovernor::updateSamples(double performanceScale) {
+  if (!m_dynamicSamples || m_maxSamples == 0) {
+    return;
+  }
+
+  if (m_scale <= m_minScale && performanceScale < 1.0) {
+    ++m_overloadedFrames;
+    m_idleFrames = 0;
+  } else if (m_scale >= m_maxScale && performanceScale > s_headroomScale) {
+    ++m_idleFrames;
+    m_overloadedFrames = 0;
+  } else {
+    m_overloadedFrames = 0;
+    m_idleFrames = 0;
+  }
+
+  if (m_overloadedFrames >= s_sustainedFrames && m_samples > 1) {
+    m_samples /= 2;
+    m_overloadedFrames = 0;
+  } else if (m_idleFrames >= s_sustainedFrames && m_samples < m_maxSamples) {
+    m_samples = std::min(m_samples * 2, m_maxSamples);
+    m_idleFrames = 0;
+  }
+}
@@ -7,16 +7,40 @@
 
 #include <oculusdevice.h>
 #include <oculusswapcallback.h>
+#include <oculustrace.h>
 
 void OculusSwapCallback::swapBuffersImplementation(osg::GraphicsContext* gc) {
+  // Decided when the frame was updated, never in idle frames
+  const bool mirror = m_device->drawFrame().mirror;
+  const bool idle = m_device->drawFrame().idle;
+  const long long frameIndex = m_frameIndex++;
+
   // Submit rendered frame to compositor
-  m_device->submitFrame(m_frameIndex++);
+  {
+    OculusTraceScope trace("submitFrame", frameIndex);
+    m_device->submitFrame(frameIndex);
+  }
 
   // Blit mirror texture to backbuffer,
   // if not already doing the blit on post draw
-  if (!m_device->blitOnPostDraw())
+  if (!m_device->blitOnPostDraw() && mirror) {
+    OculusTraceScope trace("blitMirrorTexture", frameIndex);
     m_device->blitMirrorTexture(gc);
+  }
+
+  // Record the image the compositor made of the submitted frame
+  if (!idle) {
+    OculusTraceScope trace("captureMirrorTexture", frameIndex);
+    m_device->captureMirrorTexture(gc);
+  }
+
+  // Publish the GPU times of the frames the GPU has finished
+  m_device->collectGpuTimes(gc);
 
-  // Run the default system swapBufferImplementation
-  gc->swapBuffersImplementation();
+  // Run the default system swapBufferImplementation, only when the mirror was updated since the
+  // window shows nothing else
+  if (mirror) {
+    OculusTraceScope trace("swapBuffers", frameIndex);
+    gc->swapBuffersImplementation();
+  }
 }
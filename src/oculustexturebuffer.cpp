@@ -8,364 +8,441 @@
  *      Author: Chris Denham
  */
 
-#include <osgViewer/Renderer>
+#include <algorithm>
 
 #include <glextensions.h>
-#include <oculusdrawcallbacks.h>
 #include <oculustexturebuffer.h>
 
-static osg::FrameBufferObject* getFrameBufferObject(osg::RenderInfo& renderInfo) {
-  osg::Camera* camera = renderInfo.getCurrentCamera();
-  osgViewer::Renderer* camRenderer = (dynamic_cast<osgViewer::Renderer*>(camera->getRenderer()));
-
-  if (camRenderer != nullptr) {
-    osgUtil::SceneView* sceneView = camRenderer->getSceneView(0);
-
-    if (sceneView != nullptr) {
-      osgUtil::RenderStage* renderStage = sceneView->getRenderStage();
-
-      if (renderStage != nullptr) {
-        return renderStage->getFrameBufferObject();
-      }
-    }
+// Formats used when the runtime rejects the requested ones
+static const ovrTextureFormat s_defaultColorFormat = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+static const ovrTextureFormat s_defaultDepthFormat = OVR_FORMAT_D32_FLOAT;
+
+// Internal formats of the multisample buffers, which must match the swap chain for the resolve
+static GLenum multisampleFormat(ovrTextureFormat format) {
+  switch (format) {
+    case OVR_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case OVR_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case OVR_FORMAT_B8G8R8X8_UNORM_SRGB:
+      return GL_SRGB8_ALPHA8;
+    case OVR_FORMAT_R11G11B10_FLOAT:
+      return GL_R11F_G11F_B10F;
+    case OVR_FORMAT_R16G16B16A16_FLOAT:
+      return GL_RGBA16F;
+    case OVR_FORMAT_D16_UNORM:
+      return GL_DEPTH_COMPONENT16;
+    case OVR_FORMAT_D24_UNORM_S8_UINT:
+      return GL_DEPTH24_STENCIL8;
+    case OVR_FORMAT_D32_FLOAT:
+      return GL_DEPTH_COMPONENT32F;
+    default:
+      return GL_RGBA8;
   }
-
-  return nullptr;
 }
 
 OculusTextureBuffer::OculusTextureBuffer(const ovrSession& session,
                                          osg::State* state,
                                          const ovrSizei& size,
-                                         int msaaSamples) :
+                                         int msaaSamples,
+                                         int arraySize,
+                                         bool sideBySide,
+                                         ovrTextureFormat colorFormat,
+                                         ovrTextureFormat depthFormat) :
     m_session(session),
     m_textureSize(osg::Vec2i(size.w, size.h)),
-    m_samples(msaaSamples) {
-  if (msaaSamples == 0) {
-    setup(state);
-  } else {
-    setupMSAA(state);
+    m_colorFormat(colorFormat),
+    m_depthFormat(depthFormat),
+    m_samples(msaaSamples),
+    m_arraySize(arraySize),
+    m_sideBySide(sideBySide) {
+  if (m_arraySize > 1) {
+    const OculusGLExtensions* ext = getOculusGLExtensions(*state);
+    m_multiview = ext->isMultiviewSupported;
+
+    if (!m_multiview && !ext->isLayeredRenderingSupported) {
+      osg::notify(osg::WARN) << "Warning: Layered rendering is not supported by this context!"
+                             << std::endl;
+    }
+  }
+
+  setup();
+
+  storeTextureIds();
+
+  createFramebuffers(*state);
+
+  if (m_samples != 0) {
+    createMSAATextures(*state);
+  }
+}
+
+void OculusTextureBuffer::storeTextureIds() {
+  // Look up the swap chain images once, so that rendering only needs the current index
+  int length = 0;
+  if (m_colorTextureSwapChain) {
+    ovr_GetTextureSwapChainLength(m_session, m_colorTextureSwapChain, &length);
+    m_colorTextureIds.resize(length, 0);
+    for (int i = 0; i < length; ++i) {
+      ovr_GetTextureSwapChainBufferGL(m_session, m_colorTextureSwapChain, i, &m_colorTextureIds[i]);
+    }
+    ovr_GetTextureSwapChainCurrentIndex(m_session, m_colorTextureSwapChain, &m_imageIndex);
+  }
+
+  length = 0;
+  if (m_depthTextureSwapChain) {
+    ovr_GetTextureSwapChainLength(m_session, m_depthTextureSwapChain, &length);
+    m_depthTextureIds.resize(length, 0);
+    for (int i = 0; i < length; ++i) {
+      ovr_GetTextureSwapChainBufferGL(m_session, m_depthTextureSwapChain, i, &m_depthTextureIds[i]);
+    }
   }
 }
 
-void OculusTextureBuffer::setup(osg::State* state) {
+void OculusTextureBuffer::setup() {
+  const GLenum chainTarget = m_arraySize > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
   ovrTextureSwapChainDesc desc = {};
   desc.Type = ovrTexture_2D;
-  desc.ArraySize = 1;
+  desc.ArraySize = m_arraySize;
   desc.Width = m_textureSize.x();
   desc.Height = m_textureSize.y();
   desc.MipLevels = 1;
-  desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
-  desc.SampleCount = 1;
+  desc.SampleCount = 1;  // The code doesn't currently handle MSAA textures.
   desc.StaticImage = ovrFalse;
 
-  ovrResult result = ovr_CreateTextureSwapChainGL(m_session, &desc, &m_colorTextureSwapChain);
+  ovrTextureSwapChain* swapChains[] = {&m_colorTextureSwapChain, &m_depthTextureSwapChain};
+  ovrTextureFormat* formats[] = {&m_colorFormat, &m_depthFormat};
+  const ovrTextureFormat defaultFormats[] = {s_defaultColorFormat, s_defaultDepthFormat};
+
+  for (int chain = 0; chain < 2; ++chain) {
+    ovrTextureSwapChain* swapChain = swapChains[chain];
+    desc.Format = *formats[chain];
+    ovrResult result = ovr_CreateTextureSwapChainGL(m_session, &desc, swapChain);
+
+    if (!OVR_SUCCESS(result) && desc.Format != defaultFormats[chain]) {
+      osg::notify(osg::WARN) << "Warning: Swap texture format " << desc.Format
+                             << " not supported, falling back to " << defaultFormats[chain]
+                             << "." << std::endl;
+      desc.Format = defaultFormats[chain];
+      *formats[chain] = desc.Format;
+      result = ovr_CreateTextureSwapChainGL(m_session, &desc, swapChain);
+    }
 
-  int length = 0;
-  ovr_GetTextureSwapChainLength(m_session, m_colorTextureSwapChain, &length);
+    if (!OVR_SUCCESS(result)) {
+      osg::notify(osg::WARN) << "Warning: Unable to create swap texture set! " << std::endl;
+      *swapChain = nullptr;
+      return;
+    }
+
+    int length = 0;
+    ovr_GetTextureSwapChainLength(m_session, *swapChain, &length);
 
-  if (OVR_SUCCESS(result)) {
     for (int i = 0; i < length; ++i) {
       GLuint chainTexId;
-      ovr_GetTextureSwapChainBufferGL(m_session, m_colorTextureSwapChain, i, &chainTexId);
-
-      osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D();
-
-      osg::ref_ptr<osg::Texture::TextureObject> textureObject =
-        new osg::Texture::TextureObject(texture.get(), chainTexId, GL_TEXTURE_2D);
+      ovr_GetTextureSwapChainBufferGL(m_session, *swapChain, i, &chainTexId);
+      glBindTexture(chainTarget, chainTexId);
+      glTexParameteri(chainTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(chainTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(chainTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(chainTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+  }
 
-      textureObject->setAllocated(true);
+  glBindTexture(chainTarget, 0);
+  osg::notify(osg::DEBUG_INFO) << "Successfully created the swap texture set!" << std::endl;
+}
 
-      texture->setTextureObject(state->getContextID(), textureObject.get());
+void OculusTextureBuffer::createFramebuffers(const osg::State& state) {
+  if (m_colorTextureIds.empty() || m_colorTextureIds.size() != m_depthTextureIds.size()) {
+    return;
+  }
 
-      texture->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR);
-      texture->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
-      texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
-      texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+  const GLenum chainTarget = m_arraySize > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+  const int views = viewCount();
+
+  // Attach every image once, so that the driver validates each framebuffer only once
+  m_imageFBOs.resize(m_colorTextureIds.size() * views, 0);
+  fbo_ext->glGenFramebuffers((GLsizei)m_imageFBOs.size(), m_imageFBOs.data());
+
+  for (size_t image = 0; image < m_colorTextureIds.size(); ++image) {
+    for (int view = 0; view < views; ++view) {
+      fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, m_imageFBOs[image * views + view]);
+      attachView(state, GL_COLOR_ATTACHMENT0_EXT, m_colorTextureIds[image], chainTarget, view);
+      attachView(state, depthAttachment(), m_depthTextureIds[image], chainTarget, view);
+    }
+  }
 
-      texture->setTextureSize(m_textureSize.x(), m_textureSize.y());
-      texture->setSourceFormat(GL_SRGB8_ALPHA8);
+  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+}
 
-      // Set the color buffer to be the first texture generated
-      if (i == 0) {
-        m_colorBuffer = texture;
-      }
-    }
+void OculusTextureBuffer::createMSAATextures(const osg::State& state) {
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
 
-    osg::notify(osg::DEBUG_INFO) << "Successfully created the swap texture set!" << std::endl;
+  if (m_arraySize > 1) {
+    // One multisample layer per eye, resolved layer by layer in onPostRender. Layered targets
+    // cannot be renderbuffers.
+    const OculusGLExtensions* ext = getOculusGLExtensions(state);
+
+    glGenTextures(1, &m_MSAA_ColorTex);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, m_MSAA_ColorTex);
+    ext->glTexImage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+                                 m_samples,
+                                 multisampleFormat(m_colorFormat),
+                                 m_textureSize.x(),
+                                 m_textureSize.y(),
+                                 m_arraySize,
+                                 false);
+
+    glGenTextures(1, &m_MSAA_DepthTex);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, m_MSAA_DepthTex);
+    ext->glTexImage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+                                 m_samples,
+                                 multisampleFormat(m_depthFormat),
+                                 m_textureSize.x(),
+                                 m_textureSize.y(),
+                                 m_arraySize,
+                                 false);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, 0);
   } else {
-    osg::notify(osg::WARN) << "Warning: Unable to create swap texture set! " << std::endl;
-    return;
+    // The multisample buffers are only resolved, never sampled, so they are renderbuffers
+    fbo_ext->glGenRenderbuffers(1, &m_MSAA_ColorRB);
+    fbo_ext->glBindRenderbuffer(GL_RENDERBUFFER_EXT, m_MSAA_ColorRB);
+    fbo_ext->glRenderbufferStorageMultisample(GL_RENDERBUFFER_EXT,
+                                              m_samples,
+                                              multisampleFormat(m_colorFormat),
+                                              m_textureSize.x(),
+                                              m_textureSize.y());
+
+    fbo_ext->glGenRenderbuffers(1, &m_MSAA_DepthRB);
+    fbo_ext->glBindRenderbuffer(GL_RENDERBUFFER_EXT, m_MSAA_DepthRB);
+    fbo_ext->glRenderbufferStorageMultisample(GL_RENDERBUFFER_EXT,
+                                              m_samples,
+                                              multisampleFormat(m_depthFormat),
+                                              m_textureSize.x(),
+                                              m_textureSize.y());
+    fbo_ext->glBindRenderbuffer(GL_RENDERBUFFER_EXT, 0);
   }
 
-  desc.Format = OVR_FORMAT_D32_FLOAT;
+  // The multisample framebuffers are rebuilt together with their buffers
+  m_MSAA_FBOs.resize(viewCount(), 0);
+  fbo_ext->glGenFramebuffers((GLsizei)m_MSAA_FBOs.size(), m_MSAA_FBOs.data());
+
+  for (int view = 0; view < viewCount(); ++view) {
+    fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, m_MSAA_FBOs[view]);
+
+    if (m_arraySize > 1) {
+      attachView(state,
+                 GL_COLOR_ATTACHMENT0_EXT,
+                 m_MSAA_ColorTex,
+                 GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+                 view);
+      attachView(state,
+                 depthAttachment(),
+                 m_MSAA_DepthTex,
+                 GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+                 view);
+    } else {
+      fbo_ext->glFramebufferRenderbuffer(GL_FRAMEBUFFER_EXT,
+                                         GL_COLOR_ATTACHMENT0_EXT,
+                                         GL_RENDERBUFFER_EXT,
+                                         m_MSAA_ColorRB);
+      fbo_ext->glFramebufferRenderbuffer(GL_FRAMEBUFFER_EXT,
+                                         depthAttachment(),
+                                         GL_RENDERBUFFER_EXT,
+                                         m_MSAA_DepthRB);
+    }
+  }
 
-  result = ovr_CreateTextureSwapChainGL(m_session, &desc, &m_depthTextureSwapChain);
+  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+}
 
-  length = 0;
-  ovr_GetTextureSwapChainLength(m_session, m_depthTextureSwapChain, &length);
+void OculusTextureBuffer::deleteMSAATextures(const osg::State& state) {
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
 
-  if (OVR_SUCCESS(result)) {
-    for (int i = 0; i < length; ++i) {
-      GLuint chainTexId;
-      ovr_GetTextureSwapChainBufferGL(m_session, m_depthTextureSwapChain, i, &chainTexId);
+  if (!m_MSAA_FBOs.empty()) {
+    fbo_ext->glDeleteFramebuffers((GLsizei)m_MSAA_FBOs.size(), m_MSAA_FBOs.data());
+    m_MSAA_FBOs.clear();
+  }
 
-      osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D();
+  if (m_MSAA_ColorTex) {
+    glDeleteTextures(1, &m_MSAA_ColorTex);
+    m_MSAA_ColorTex = 0;
+  }
 
-      osg::ref_ptr<osg::Texture::TextureObject> textureObject =
-        new osg::Texture::TextureObject(texture.get(), chainTexId, GL_TEXTURE_2D);
+  if (m_MSAA_DepthTex) {
+    glDeleteTextures(1, &m_MSAA_DepthTex);
+    m_MSAA_DepthTex = 0;
+  }
 
-      textureObject->setAllocated(true);
+  if (m_MSAA_ColorRB) {
+    fbo_ext->glDeleteRenderbuffers(1, &m_MSAA_ColorRB);
+    m_MSAA_ColorRB = 0;
+  }
 
-      texture->setTextureObject(state->getContextID(), textureObject.get());
+  if (m_MSAA_DepthRB) {
+    fbo_ext->glDeleteRenderbuffers(1, &m_MSAA_DepthRB);
+    m_MSAA_DepthRB = 0;
+  }
+}
 
-      texture->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR);
-      texture->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
-      texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
-      texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
-      texture->setTextureSize(m_textureSize.x(), m_textureSize.y());
-      texture->setSourceFormat(GL_DEPTH_COMPONENT);
-      if (i == 0) {
-        m_depthBuffer = texture;
-      }
-    }
-  } else {
-    osg::notify(osg::WARN) << "Warning: Unable to create swap texture set! " << std::endl;
+void OculusTextureBuffer::setRenderSamples(const osg::State& state, int samples) {
+  // Switching between MSAA and non MSAA rendering would change how the target is bound
+  if (m_samples == 0 || samples <= 0 || samples == m_samples) {
     return;
   }
+
+  // Only the multisample render target is reallocated, never the swap chains
+  deleteMSAATextures(state);
+  m_samples = samples;
+  createMSAATextures(state);
 }
 
-void OculusTextureBuffer::setupMSAA(osg::State* state) {
-  const OSG_GLExtensions* fbo_ext = getGLExtensions(*state);
+void OculusTextureBuffer::onPreRender(osg::RenderInfo& renderInfo, int layer) {
+  const osg::State& state = *renderInfo.getState();
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
 
-  ovrTextureSwapChainDesc desc = {};
-  desc.Type = ovrTexture_2D;
-  desc.ArraySize = 1;
-  desc.Width = m_textureSize.x();
-  desc.Height = m_textureSize.y();
-  desc.MipLevels = 1;
-  desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
-  desc.SampleCount = 1;  // The code doesn't currently handle MSAA textures.
-  desc.StaticImage = ovrFalse;
+  // Both eyes of a side by side texture render into the same framebuffer
+  const int view = viewIndex(layer);
+  GLuint fbo = imageFramebuffer(view);
+  if (m_samples != 0) {
+    fbo = m_MSAA_FBOs.empty() ? 0 : m_MSAA_FBOs[view];
+  }
 
-  {
-    ovrResult result = ovr_CreateTextureSwapChainGL(m_session, &desc, &m_colorTextureSwapChain);
+  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, fbo);
 
-    int length = 0;
-    ovr_GetTextureSwapChainLength(m_session, m_colorTextureSwapChain, &length);
+  // The previous contents are never read, except for the eye already drawn to the left half of a
+  // side by side texture
+  if (fbo != 0 && !(m_sideBySide && layer == 1)) {
+    invalidate(state, GL_FRAMEBUFFER_EXT, fbo);
+  }
+}
+
+void OculusTextureBuffer::onPostRender(osg::RenderInfo& renderInfo, int layer) {
+  const osg::State& state = *renderInfo.getState();
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
 
-    if (OVR_SUCCESS(result)) {
-      for (int i = 0; i < length; ++i) {
-        GLuint chainTexId;
-        ovr_GetTextureSwapChainBufferGL(m_session, m_colorTextureSwapChain, i, &chainTexId);
-        glBindTexture(GL_TEXTURE_2D, chainTexId);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      }
+  // Collect the viewports drawn since the last resolve, so that only they are resolved
+  const osg::Viewport* viewport = state.getCurrentViewport();
+  if (viewport != nullptr) {
+    const int x = (int)viewport->x();
+    const int y = (int)viewport->y();
+    const int w = (int)viewport->width();
+    const int h = (int)viewport->height();
+
+    if (m_drawnRegion.z() <= 0 || m_drawnRegion.w() <= 0) {
+      m_drawnRegion.set(x, y, w, h);
+    } else {
+      const int x0 = std::min(x, m_drawnRegion.x());
+      const int y0 = std::min(y, m_drawnRegion.y());
+      const int x1 = std::max(x + w, m_drawnRegion.x() + m_drawnRegion.z());
+      const int y1 = std::max(y + h, m_drawnRegion.y() + m_drawnRegion.w());
+      m_drawnRegion.set(x0, y0, x1 - x0, y1 - y0);
     }
   }
-  desc.Format = OVR_FORMAT_D32_FLOAT;
-
-  {
-    ovrResult result = ovr_CreateTextureSwapChainGL(m_session, &desc, &m_depthTextureSwapChain);
 
-    int length = 0;
-    ovr_GetTextureSwapChainLength(m_session, m_depthTextureSwapChain, &length);
+  // A side by side texture is resolved once both eyes have been rendered
+  if (m_sideBySide && layer == 0) {
+    return;
+  }
 
-    if (OVR_SUCCESS(result)) {
-      for (int i = 0; i < length; ++i) {
-        GLuint chainTexId;
-        ovr_GetTextureSwapChainBufferGL(m_session, m_depthTextureSwapChain, i, &chainTexId);
-        glBindTexture(GL_TEXTURE_2D, chainTexId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      }
+  if (m_samples != 0 && !m_MSAA_FBOs.empty()) {
+    // Resolve one layer at a time, since blits cannot address layered attachments. The depth is
+    // resolved as well, for positional timewarp. Afterwards the multisample contents are
+    // discarded, so that they never have to be written back to memory.
+    const int firstView = viewIndex(layer == ALL_LAYERS ? 0 : layer);
+    const int lastView = viewIndex(layer == ALL_LAYERS ? m_arraySize - 1 : layer);
+    for (int view = firstView; view <= lastView; ++view) {
+      invalidate(state, GL_DRAW_FRAMEBUFFER_EXT, imageFramebuffer(view));
+      blit(state, m_MSAA_FBOs[view], imageFramebuffer(view));
+      invalidate(state, GL_READ_FRAMEBUFFER_EXT, m_MSAA_FBOs[view]);
     }
   }
 
-  // Create an FBO for output to Oculus swap texture set.
-  fbo_ext->glGenFramebuffers(1, &m_Oculus_FBO);
-
-  // Create an FBO for primary render target.
-  fbo_ext->glGenFramebuffers(1, &m_MSAA_FBO);
-
-  // We don't want to support MIPMAP so, ensure only level 0 is allowed.
-  const int maxTextureLevel = 0;
-
-  const OSG_Texture_Extensions* extensions = getTextureExtensions(*state);
-
-  // Create MSAA color buffer
-  glGenTextures(1, &m_MSAA_ColorTex);
-  glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, m_MSAA_ColorTex);
-  extensions->glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE,
-                                      m_samples,
-                                      GL_RGBA,
-                                      m_textureSize.x(),
-                                      m_textureSize.y(),
-                                      false);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_ARB);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER_ARB);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAX_LEVEL, maxTextureLevel);
-
-  // Create MSAA depth buffer
-  glGenTextures(1, &m_MSAA_DepthTex);
-  glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, m_MSAA_DepthTex);
-  extensions->glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE,
-                                      m_samples,
-                                      GL_DEPTH_COMPONENT,
-                                      m_textureSize.x(),
-                                      m_textureSize.y(),
-                                      false);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAX_LEVEL, maxTextureLevel);
+  m_drawnRegion.set(0, 0, 0, 0);
+  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
 }
 
-void OculusTextureBuffer::onPreRender(osg::RenderInfo& renderInfo) {
-  GLuint curColTexId = 0;
-  if (m_colorTextureSwapChain) {
-    int curIndex;
-    ovr_GetTextureSwapChainCurrentIndex(m_session, m_colorTextureSwapChain, &curIndex);
-    ovr_GetTextureSwapChainBufferGL(m_session, m_colorTextureSwapChain, curIndex, &curColTexId);
+void OculusTextureBuffer::invalidate(const osg::State& state, GLenum target, GLuint fbo) const {
+  // The attachments are invalid names for the default framebuffer
+  if (fbo == 0) {
+    return;
   }
 
-  GLuint curDepthTexId = 0;
-  if (m_depthTextureSwapChain) {
-    int curIndex;
-    ovr_GetTextureSwapChainCurrentIndex(m_session, m_depthTextureSwapChain, &curIndex);
-    ovr_GetTextureSwapChainBufferGL(m_session, m_depthTextureSwapChain, curIndex, &curDepthTexId);
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  const GLenum attachments[] = {GL_COLOR_ATTACHMENT0_EXT, depthAttachment()};
+
+  if (ext->isDirectStateAccessSupported) {
+    ext->glInvalidateNamedFramebufferData(fbo, 2, attachments);
+  } else if (ext->isInvalidateSupported) {
+    getGLExtensions(state)->glBindFramebuffer(target, fbo);
+    ext->glInvalidateFramebuffer(target, 2, attachments);
   }
+}
 
-  const osg::State& state = *renderInfo.getState();
-  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+void OculusTextureBuffer::blit(const osg::State& state, GLuint readFbo, GLuint drawFbo) const {
+  // Only the drawn region is resolved, the compositor never samples outside the eye viewports
+  int x0 = 0;
+  int y0 = 0;
+  int x1 = m_textureSize.x();
+  int y1 = m_textureSize.y();
+  if (m_drawnRegion.z() > 0 && m_drawnRegion.w() > 0) {
+    x0 = std::max(x0, m_drawnRegion.x());
+    y0 = std::max(y0, m_drawnRegion.y());
+    x1 = std::min(x1, m_drawnRegion.x() + m_drawnRegion.z());
+    y1 = std::min(y1, m_drawnRegion.y() + m_drawnRegion.w());
+  }
 
-  if (m_samples == 0) {
-    const osg::FrameBufferObject* fbo = getFrameBufferObject(renderInfo);
+  GLbitfield mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+  if (hasStencil()) {
+    mask |= GL_STENCIL_BUFFER_BIT;
+  }
 
-    if (fbo == nullptr) {
-      return;
-    }
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
 
-    const unsigned int ctx = state.getContextID();
-    fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, fbo->getHandle(ctx));
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_COLOR_ATTACHMENT0_EXT,
-                                    GL_TEXTURE_2D,
-                                    curColTexId,
-                                    0);
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_DEPTH_ATTACHMENT_EXT,
-                                    GL_TEXTURE_2D,
-                                    curDepthTexId,
-                                    0);
+  if (ext->isDirectStateAccessSupported) {
+    ext->glBlitNamedFramebuffer(readFbo, drawFbo, x0, y0, x1, y1, x0, y0, x1, y1, mask, GL_NEAREST);
   } else {
-    fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, m_MSAA_FBO);
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_COLOR_ATTACHMENT0_EXT,
-                                    GL_TEXTURE_2D_MULTISAMPLE,
-                                    m_MSAA_ColorTex,
-                                    0);
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_DEPTH_ATTACHMENT_EXT,
-                                    GL_TEXTURE_2D_MULTISAMPLE,
-                                    m_MSAA_DepthTex,
-                                    0);
+    const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+    fbo_ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, readFbo);
+    fbo_ext->glBindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, drawFbo);
+    fbo_ext->glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, mask, GL_NEAREST);
   }
 }
-void OculusTextureBuffer::onPostRender(osg::RenderInfo& renderInfo) {
+
+void OculusTextureBuffer::commit() {
+  // Called once per frame after all views have been rendered, which advances the current image
   if (m_colorTextureSwapChain) {
     ovr_CommitTextureSwapChain(m_session, m_colorTextureSwapChain);
+    ovr_GetTextureSwapChainCurrentIndex(m_session, m_colorTextureSwapChain, &m_imageIndex);
   }
 
   if (m_depthTextureSwapChain) {
     ovr_CommitTextureSwapChain(m_session, m_depthTextureSwapChain);
   }
+}
 
-  const osg::State& state = *renderInfo.getState();
-  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
-
-  if (m_samples == 0) {
-    const osg::FrameBufferObject* fbo = getFrameBufferObject(renderInfo);
-
-    if (fbo == nullptr) {
-      return;
-    }
-
-    // Avoids an error when calling onPreRender during next iteration.
-    // Without this, during the next while loop iteration onPreRender
-    // would bind a framebuffer with an invalid COLOR_ATTACHMENT0 because the texture ID
-    // associated with COLOR_ATTACHMENT0 had been unlocked by calling wglDXUnlockObjectsNV.
-    const unsigned int ctx = state.getContextID();
-    fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, fbo->getHandle(ctx));
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_COLOR_ATTACHMENT0_EXT,
-                                    GL_TEXTURE_2D,
-                                    0,
-                                    0);
-    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
-                                    GL_DEPTH_ATTACHMENT_EXT,
-                                    GL_TEXTURE_2D,
-                                    0,
-                                    0);
-
-    return;
-  }
+GLenum OculusTextureBuffer::depthAttachment() const {
+  return hasStencil() ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT_EXT;
+}
 
-  // Get texture id
-  GLuint curColTexId = 0;
-  GLuint curDepthTexId = 0;
-  if (m_colorTextureSwapChain) {
-    int curIndex;
-    ovr_GetTextureSwapChainCurrentIndex(m_session, m_colorTextureSwapChain, &curIndex);
-    ovr_GetTextureSwapChainBufferGL(m_session, m_colorTextureSwapChain, curIndex, &curColTexId);
-  }
+void OculusTextureBuffer::attachView(const osg::State& state,
+                                     GLenum attachment,
+                                     GLuint texId,
+                                     GLenum target,
+                                     int view) const {
+  const OculusGLExtensions* ext = getOculusGLExtensions(state);
+  const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
 
-  if (m_depthTextureSwapChain) {
-    int curIndex;
-    ovr_GetTextureSwapChainCurrentIndex(m_session, m_depthTextureSwapChain, &curIndex);
-    ovr_GetTextureSwapChainBufferGL(m_session, m_depthTextureSwapChain, curIndex, &curDepthTexId);
+  if (m_arraySize == 1) {
+    fbo_ext->glFramebufferTexture2D(GL_FRAMEBUFFER_EXT, attachment, target, texId, 0);
+  } else if (view != 0) {
+    fbo_ext->glFramebufferTextureLayer(GL_FRAMEBUFFER_EXT, attachment, texId, 0, view - 1);
+  } else if (m_multiview) {
+    ext->glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER_EXT, attachment, texId, 0, 0, m_arraySize);
+  } else if (ext->isLayeredRenderingSupported) {
+    // Geometry shader fallback, the shader selects the eye through gl_Layer
+    ext->glFramebufferTexture(GL_FRAMEBUFFER_EXT, attachment, texId, 0);
   }
-
-  fbo_ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, m_MSAA_FBO);
-  fbo_ext->glFramebufferTexture2D(GL_READ_FRAMEBUFFER_EXT,
-                                  GL_COLOR_ATTACHMENT0_EXT,
-                                  GL_TEXTURE_2D_MULTISAMPLE,
-                                  m_MSAA_ColorTex,
-                                  0);
-  fbo_ext->glFramebufferRenderbuffer(GL_READ_FRAMEBUFFER_EXT,
-                                     GL_DEPTH_ATTACHMENT_EXT,
-                                     GL_RENDERBUFFER_EXT,
-                                     0);
-
-  fbo_ext->glBindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, m_Oculus_FBO);
-  fbo_ext->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER_EXT,
-                                  GL_COLOR_ATTACHMENT0_EXT,
-                                  GL_TEXTURE_2D,
-                                  curColTexId,
-                                  0);
-  fbo_ext->glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER_EXT,
-                                     GL_DEPTH_ATTACHMENT_EXT,
-                                     GL_RENDERBUFFER_EXT,
-                                     0);
-  fbo_ext->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER_EXT,
-                                  GL_DEPTH_ATTACHMENT_EXT,
-                                  GL_TEXTURE_2D,
-                                  curDepthTexId,
-                                  0);
-
-  int w = m_textureSize.x();
-  int h = m_textureSize.y();
-  fbo_ext->glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-
-  fbo_ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
 }
 
 void OculusTextureBuffer::destroy(osg::GraphicsContext* gc) {
@@ -375,28 +452,16 @@ void OculusTextureBuffer::destroy(osg::GraphicsContext* gc) {
   m_depthTextureSwapChain = nullptr;
 
   if (gc) {
-    const OSG_GLExtensions* fbo_ext = getGLExtensions(*(gc->getState()));
-    if (m_Oculus_FBO) {
-      fbo_ext->glDeleteFramebuffers(1, &m_Oculus_FBO);
-      m_Oculus_FBO = 0;
-    }
-
-    if (m_MSAA_FBO) {
-      fbo_ext->glDeleteFramebuffers(1, &m_MSAA_FBO);
-      m_MSAA_FBO = 0;
+    const osg::State& state = *gc->getState();
+    const OSG_GLExtensions* fbo_ext = getGLExtensions(state);
+    if (!m_imageFBOs.empty()) {
+      fbo_ext->glDeleteFramebuffers((GLsizei)m_imageFBOs.size(), m_imageFBOs.data());
+      m_imageFBOs.clear();
     }
 
-    if (m_MSAA_ColorTex) {
-      fbo_ext->glDeleteFramebuffers(1, &m_MSAA_ColorTex);
-      m_MSAA_ColorTex = 0;
-    }
-
-    if (m_MSAA_DepthTex) {
-      fbo_ext->glDeleteFramebuffers(1, &m_MSAA_DepthTex);
-      m_MSAA_DepthTex = 0;
-    }
+    deleteMSAATextures(state);
   }
 
-  m_colorBuffer = nullptr;
-  m_depthBuffer = nullptr;
+  m_colorTextureIds.clear();
+  m_depthTextureIds.clear();
 }
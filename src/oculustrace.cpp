@@ -0,0 +1,133 @@
+/*
+ * oculustrace.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#include <osg/Notify>
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+#include <oculustrace.h>
+
+struct OculusTraceEvent {
+  const char* name;
+  osg::Timer_t start;
+  osg::Timer_t end;
+  long long frameIndex;
+  unsigned int threadId;
+  // Number of the span stored in the slot, or s_noEvent while the slot is being written
+  std::atomic<unsigned long long> sequence;
+};
+
+static const unsigned long long s_noEvent = ~0ull;
+
+static std::unique_ptr<OculusTraceEvent[]> s_events;
+static unsigned int s_capacity = 0;
+static std::atomic<unsigned long long> s_nextEvent(0);
+static std::atomic<unsigned int> s_threadCount(0);
+static std::string s_outputFile = "oculustrace.json";
+
+static unsigned int currentThreadId() {
+  // Small sequential ids are easier to read in the trace viewer than native thread ids
+  thread_local unsigned int threadId = ++s_threadCount;
+  return threadId;
+}
+
+std::atomic<bool> OculusTrace::s_enabled(false);
+
+void OculusTrace::enable(unsigned int capacity) {
+  if (!s_events && capacity > 0) {
+    s_events.reset(new OculusTraceEvent[capacity]);
+    s_capacity = capacity;
+
+    for (unsigned int i = 0; i < capacity; ++i) {
+      s_events[i].sequence.store(s_noEvent, std::memory_order_relaxed);
+    }
+  }
+
+  s_enabled.store(s_events != nullptr, std::memory_order_release);
+}
+
+void OculusTrace::record(const char* name,
+                         long long frameIndex,
+                         osg::Timer_t start,
+                         osg::Timer_t end) {
+  const unsigned long long index = s_nextEvent.fetch_add(1, std::memory_order_relaxed);
+
+  // Overwrites the oldest span once the buffer has wrapped
+  OculusTraceEvent& event = s_events[index % s_capacity];
+  event.sequence.store(s_noEvent, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  event.frameIndex = frameIndex;
+  event.threadId = currentThreadId();
+  event.sequence.store(index, std::memory_order_release);
+}
+
+void OculusTrace::setOutputFile(const std::string& filename) {
+  s_outputFile = filename;
+}
+
+bool OculusTrace::write() {
+  return write(s_outputFile);
+}
+
+bool OculusTrace::write(const std::string& filename) {
+  std::ofstream file(filename.c_str());
+
+  if (!file) {
+    osg::notify(osg::WARN) << "Warning: Unable to write trace to " << filename << std::endl;
+    return false;
+  }
+
+  const osg::Timer* timer = osg::Timer::instance();
+  const unsigned long long recorded = s_nextEvent.load(std::memory_order_acquire);
+  const unsigned long long oldest = recorded > s_capacity ? recorded - s_capacity : 0;
+
+  // Timestamps in microseconds, keeping their resolution however long the session ran
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[";
+
+  bool first = true;
+  for (unsigned long long index = oldest; index < recorded; ++index) {
+    const OculusTraceEvent& slot = s_events[index % s_capacity];
+
+    // Skip spans still being written, or already overwritten, by another thread
+    if (slot.sequence.load(std::memory_order_acquire) != index) {
+      continue;
+    }
+
+    const char* name = slot.name;
+    const osg::Timer_t start = slot.start;
+    const osg::Timer_t end = slot.end;
+    const long long frameIndex = slot.frameIndex;
+    const unsigned int threadId = slot.threadId;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != index) {
+      continue;
+    }
+
+    file << (first ? "\n" : ",\n");
+    file << "{\"name\":\"" << name << "\",\"cat\":\"oculus\",\"ph\":\"X\""
+         << ",\"ts\":" << timer->delta_u(timer->getStartTick(), start)
+         << ",\"dur\":" << timer->delta_u(start, end) << ",\"pid\":1"
+         << ",\"tid\":" << threadId << ",\"args\":{\"frame\":" << frameIndex << "}}";
+    first = false;
+  }
+
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (oldest > 0) {
+    osg::notify(osg::NOTICE) << "Trace buffer wrapped, the oldest " << oldest
+                             << " spans were overwritten." << std::endl;
+  }
+
+  return true;
+}
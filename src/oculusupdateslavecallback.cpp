@@ -7,14 +7,104 @@
 
 #include <oculusdevice.h>
 #include <oculusswapcallback.h>
+#include <oculustrace.h>
 #include <oculusupdateslavecallback.h>
 
+static void setViewport(osg::Camera* camera, const ovrRecti& rect) {
+  osg::Viewport* viewport = camera->getViewport();
+
+  if (viewport == nullptr) {
+    camera->setViewport(rect.Pos.x, rect.Pos.y, rect.Size.w, rect.Size.h);
+    return;
+  }
+
+  // Updated in place, so that no viewport is allocated per frame
+  if (viewport->x() != rect.Pos.x || viewport->y() != rect.Pos.y ||
+      viewport->width() != rect.Size.w || viewport->height() != rect.Size.h) {
+    viewport->setViewport(rect.Pos.x, rect.Pos.y, rect.Size.w, rect.Size.h);
+  }
+}
+
 void OculusUpdateSlaveCallback::updateSlave(osg::View& view, osg::View::Slave& slave) {
   // We need to call these functions for the first camera, which currently is the left camera
-  if (m_cameraType == LEFT_CAMERA) {
-    m_device->waitToBeginFrame(m_swapCallback->frameIndex());
-    m_device->beginFrame(m_swapCallback->frameIndex());
-    m_device->updatePose(m_swapCallback->frameIndex());
+  if (m_cameraType == LEFT_CAMERA || m_cameraType == STEREO_CAMERA) {
+    // The frame index is counted here rather than taken from the swap callback, since the draw
+    // thread may still be drawing the previous frame
+    const long long frameIndex = m_device->advanceFrameIndex();
+    m_device->updateSessionStatus();
+    {
+      OculusTraceScope trace("waitToBeginFrame", frameIndex);
+      m_device->waitToBeginFrame(frameIndex);
+    }
+    {
+      OculusTraceScope trace("beginFrame", frameIndex);
+      m_device->beginFrame(frameIndex);
+    }
+    {
+      OculusTraceScope trace("updatePose", frameIndex);
+      m_device->updatePose(frameIndex);
+    }
+    m_device->updatePerformanceStats(view.getFrameStamp()->getFrameNumber());
+    m_device->updateDynamicResolution();
+    m_device->updateQuadLayers();
+    m_device->updateMirror();
+
+    if (m_device->updateFrame().idle) {
+      OculusTraceScope trace("idle", frameIndex);
+      m_device->idle();
+    }
+  }
+
+  // Idle frames neither cull nor clear, and the draw callbacks leave the eye textures alone. The
+  // masks are only changed when entering or leaving idle, keeping those set by the application.
+  const bool idle = m_device->updateFrame().idle;
+  if (idle != m_idle) {
+    osg::Camera* camera = slave._camera.get();
+
+    if (idle) {
+      m_clearMask = camera->getClearMask();
+      m_inheritanceMask = camera->getInheritanceMask();
+      // Otherwise the cull mask of the master camera is inherited again by the slave update
+      camera->setInheritanceMask(m_inheritanceMask & ~osg::CullSettings::CULL_MASK);
+      camera->setCullMask(0u);
+      camera->setClearMask(0);
+    } else {
+      camera->setInheritanceMask(m_inheritanceMask);
+      camera->setCullMask(view.getCamera()->getCullMask());
+      camera->setClearMask(m_clearMask);
+    }
+
+    m_idle = idle;
+  }
+
+  OculusTraceScope trace("updateSlave", m_device->updateFrame().frameIndex);
+
+  if (m_cameraType == STEREO_CAMERA) {
+    // Cull both eyes at once, the eyes are separated by their projections while drawing
+    slave._camera.get()->setViewMatrix(view.getCamera()->getViewMatrix() *
+                                       m_device->cullViewMatrix());
+    slave._camera.get()->setProjectionMatrix(m_device->cullProjectionMatrix());
+
+    setViewport(slave._camera.get(), m_device->eyeViewport(OculusDevice::Eye::LEFT));
+
+    // Multiview shaders transform the eye space of the cull view to each eye
+    osg::StateSet* stateSet = slave._camera->getStateSet();
+    osg::Uniform* eyeView = stateSet ? stateSet->getUniform("oculus_ViewMatrix") : nullptr;
+    if (eyeView) {
+      eyeView->setElement(0, m_device->stereoViewMatrix(OculusDevice::Eye::LEFT));
+      eyeView->setElement(1, m_device->stereoViewMatrix(OculusDevice::Eye::RIGHT));
+    }
+
+    osg::Uniform* projection = stateSet ? stateSet->getUniform("oculus_ProjectionMatrix") : nullptr;
+    if (projection) {
+      projection->setElement(0, m_device->projectionMatrix(OculusDevice::Eye::LEFT));
+      projection->setElement(1, m_device->projectionMatrix(OculusDevice::Eye::RIGHT));
+    }
+
+    m_device->updateTimewarpProjection(OculusDevice::Eye::LEFT);
+
+    slave.updateSlaveImplementation(view);
+    return;
   }
 
   // Get the view and projection matrix for the view
@@ -25,6 +115,11 @@ void OculusUpdateSlaveCallback::updateSlave(osg::View& view, osg::View::Slave& s
 
   slave._camera.get()->setViewMatrix(view.getCamera()->getViewMatrix() * viewMatrix);
   slave._camera.get()->setProjectionMatrix(projectionMatrix);
+
+  // Follow the dynamic resolution scale
+  setViewport(slave._camera.get(),
+              m_device->eyeViewport(m_cameraType == LEFT_CAMERA ? OculusDevice::Eye::LEFT :
+                                                                  OculusDevice::Eye::RIGHT));
   m_device->updateTimewarpProjection(m_cameraType == LEFT_CAMERA ? OculusDevice::Eye::LEFT :
                                                                    OculusDevice::Eye::RIGHT);
 
@@ -9,32 +9,107 @@
 
 #include <oculusdevice.h>
 #include <oculusgraphicsoperation.h>
+#include <oculusquadlayer.h>
 #include <oculusswapcallback.h>
 #include <oculusupdateslavecallback.h>
 #include <oculusviewer.h>
 
+OculusViewer::OculusViewer(osgViewer::Viewer* viewer,
+                           OculusDevice* dev,
+                           OculusRealizeOperation* realizeOperation) :
+    osg::Group(),
+    m_viewer(viewer),
+    m_device(dev),
+    m_realizeOperation(realizeOperation) {
+  realizeOperation->setViewer(this);
+}
+
 void OculusViewer::traverse(osg::NodeVisitor& nv) {
-  // Must be realized before any traversal
-  if (m_realizeOperation->realized()) {
+  // Usually configured by the realize operation. Otherwise, when the viewer was realized before
+  // this node existed, only the update traversal configures the viewer, since the cull traversals
+  // may run on several threads at once.
+  if (nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR && m_realizeOperation->realized()) {
     if (!m_configured) {
       configure();
     }
+
+    if (m_device->shouldQuit()) {
+      m_viewer->setDone(true);
+    }
+
+    if (m_configured && m_lodController.valid()) {
+      updateLOD();
+    }
   }
 
   osg::Group::traverse(nv);
 }
 
 void OculusViewer::configure() {
+  if (m_configured) {
+    return;
+  }
+
   osg::ref_ptr<osg::GraphicsContext> gc = m_viewer->getCamera()->getGraphicsContext();
 
   // Attach a callback to detect swap
   osg::ref_ptr<OculusSwapCallback> swapCallback = new OculusSwapCallback(m_device.get());
   gc->setSwapCallback(swapCallback.get());
 
+  // Publish the GPU times of the eyes in the viewer stats
+  m_device->setStats(m_viewer->getViewerStats());
+
   osg::ref_ptr<osg::Camera> camera = m_viewer->getCamera();
   camera->setName("Main");
   osg::Vec4 clearColor = camera->getClearColor();
 
+  if (m_device->stereoMode() != OculusDevice::StereoMode::SEPARATE_CAMERAS) {
+    // Create a single RTT camera culling both eyes
+    osg::Camera* cameraRTT =
+      m_device->createStereoRTTCamera(osg::Camera::ABSOLUTE_RF, clearColor, gc.get());
+    cameraRTT->setName("StereoRTT");
+    m_eyeCameras.push_back(cameraRTT);
+
+    m_viewer->addSlave(cameraRTT,
+                       m_device->cullProjectionMatrix(),
+                       m_device->cullViewMatrix(),
+                       true);
+
+    osg::View::Slave* stereoSlaveView = m_viewer->findSlaveForCamera(cameraRTT);
+    if (stereoSlaveView) {
+      stereoSlaveView->_updateSlaveCallback =
+        new OculusUpdateSlaveCallback(OculusUpdateSlaveCallback::STEREO_CAMERA,
+                                      m_device.get(),
+                                      swapCallback.get());
+    } else {
+      osg::notify(osg::FATAL) << "Error: Unable to acquire stereo slave view!" << std::endl;
+    }
+  } else {
+    configureSeparateCameras(clearColor, swapCallback.get());
+  }
+
+  // Quad layers draw their own subgraphs at their own rate, after the eye cameras
+  for (const osg::ref_ptr<OculusQuadLayer>& layer : m_device->quadLayers()) {
+    m_viewer->addSlave(m_device->setupQuadLayerCamera(layer.get(), gc.get()), false);
+  }
+
+  // Use sky light instead of headlight to avoid light changes when head movements
+  m_viewer->setLightingMode(osg::View::SKY_LIGHT);
+
+  // this flag needs to be set to avoid the following GL warning at every frame:
+  // Warning: detected OpenGL error 'invalid operation' at after RenderBin::draw(..)
+  m_viewer->setReleaseContextAtEndOfFrameHint(false);
+
+  // Disable rendering of main camera since its being overwritten by the swap texture anyway
+  camera->setGraphicsContext(nullptr);
+
+  m_configured = true;
+}
+
+void OculusViewer::configureSeparateCameras(const osg::Vec4& clearColor,
+                                            OculusSwapCallback* swapCallback) {
+  osg::ref_ptr<osg::GraphicsContext> gc = m_viewer->getCamera()->getGraphicsContext();
+
   // Create RTT cameras and attach textures
   osg::Camera* cameraRTTLeft = m_device->createRTTCamera(OculusDevice::Eye::LEFT,
                                                          osg::Camera::ABSOLUTE_RF,
@@ -46,6 +121,8 @@ void OculusViewer::configure() {
                                                           gc.get());
   cameraRTTLeft->setName("LeftRTT");
   cameraRTTRight->setName("RightRTT");
+  m_eyeCameras.push_back(cameraRTTLeft);
+  m_eyeCameras.push_back(cameraRTTRight);
 
   // Add RTT cameras as slaves, specifying offsets for the projection
   m_viewer->addSlave(cameraRTTLeft,
@@ -64,7 +141,7 @@ void OculusViewer::configure() {
     leftSlaveView->_updateSlaveCallback =
       new OculusUpdateSlaveCallback(OculusUpdateSlaveCallback::LEFT_CAMERA,
                                     m_device.get(),
-                                    swapCallback.get());
+                                    swapCallback);
   } else {
     osg::notify(osg::FATAL) << "Error: Unable to acquire left slave view!" << std::endl;
   }
@@ -74,20 +151,49 @@ void OculusViewer::configure() {
     rightSlaveView->_updateSlaveCallback =
       new OculusUpdateSlaveCallback(OculusUpdateSlaveCallback::RIGHT_CAMERA,
                                     m_device.get(),
-                                    swapCallback.get());
+                                    swapCallback);
   } else {
     osg::notify(osg::FATAL) << "Error: Unable to acquire right slave view!" << std::endl;
   }
+}
 
-  // Use sky light instead of headlight to avoid light changes when head movements
-  m_viewer->setLightingMode(osg::View::SKY_LIGHT);
+void OculusViewer::setParallelCull(bool enabled) {
+  m_parallelCull = enabled;
 
-  // this flag needs to be set to avoid the following GL warning at every frame:
-  // Warning: detected OpenGL error 'invalid operation' at after RenderBin::draw(..)
-  m_viewer->setReleaseContextAtEndOfFrameHint(false);
+  // The viewer starts the cull threads when it is realized, after the realize operation has added
+  // the eye cameras, so no threads are restarted while a frame is running
+  if (enabled) {
+    m_viewer->setThreadingModel(osgViewer::ViewerBase::CullThreadPerCameraDrawThreadPerContext);
+  }
+}
 
-  // Disable rendering of main camera since its being overwritten by the swap texture anyway
-  camera->setGraphicsContext(nullptr);
+void OculusViewer::setLODControl(bool enabled,
+                                 float maxLODScale,
+                                 float minPixelSize,
+                                 float maxPixelSize) {
+  m_lodController =
+    enabled ? new OculusLODController(maxLODScale, minPixelSize, maxPixelSize) : nullptr;
+  m_smallFeatureCulling = enabled && maxPixelSize > 0.0f;
+}
 
-  m_configured = true;
+void OculusViewer::updateLOD() {
+  m_lodController->update(m_device->performanceStats(),
+                          1.0 / m_device->hmdDescription().DisplayRefreshRate);
+
+  // The same values for every eye camera, so that both eyes always see the same geometry
+  const float lodScale = m_lodController->lodScale();
+  const float pixelSize = m_lodController->smallFeatureCullingPixelSize();
+
+  for (const osg::observer_ptr<osg::Camera>& camera : m_eyeCameras) {
+    if (!camera.valid()) {
+      continue;
+    }
+
+    camera->setLODScale(lodScale);
+
+    if (m_smallFeatureCulling) {
+      camera->setCullingMode(camera->getCullingMode() | osg::CullSettings::SMALL_FEATURE_CULLING);
+      camera->setSmallFeatureCullingPixelSize(pixelSize);
+    }
+  }
 }
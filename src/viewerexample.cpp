@@ -9,16 +9,51 @@
 #include <osgGA/TrackballManipulator>
 #include <osgUtil/GLObjectsVisitor>
 #include <osgViewer/Viewer>
+#include <osgViewer/ViewerEventHandlers>
+
+#include <utility>
 
 #include <oculusdevice.h>
 #include <oculuseventhandler.h>
+#include <oculusgputimer.h>
 #include <oculusgraphicsoperation.h>
+#include <oculusmirrorcapture.h>
 #include <oculustouchmanipulator.h>
+#include <oculustrace.h>
 #include <oculusviewer.h>
 
 int main(int argc, char** argv) {
   // use an ArgumentParser object to manage the program arguments.
   osg::ArgumentParser arguments(&argc, argv);
+  // cull both eyes in a single traversal
+  bool sharedCull = arguments.read("--shared-cull");
+  // cull both eyes once and draw them in a single pass with GL_OVR_multiview2
+  bool multiview = arguments.read("--multiview");
+  // cull the eyes in parallel on threads of their own
+  bool parallelCull = arguments.read("--parallel-cull");
+  // sample the eye poses again right before drawing
+  bool lateLatching = arguments.read("--late-latch");
+  // render both eyes into a single texture array
+  bool textureArray = arguments.read("--texture-array");
+  // render both eyes side by side into a single texture
+  bool sideBySide = arguments.read("--side-by-side");
+  // skip the pixels hidden by the lenses
+  bool hiddenAreaMask = arguments.read("--hidden-area-mask");
+  // scale the rendered resolution to hold the display frame rate
+  bool dynamicResolution = arguments.read("--dynamic-resolution");
+  // lower the level of detail of the scene while frames run over budget
+  bool lodControl = arguments.read("--lod-control");
+  // stop drawing while the headset is not worn or the application is not visible in it
+  bool idleWhenNotVisible = arguments.read("--idle-when-not-visible");
+  // record the mirror texture to a YUV4MPEG2 file
+  std::string recordFile;
+  arguments.read("--record", recordFile);
+  // record a timeline of the frame loop, written on exit or by pressing T
+  std::string traceFile;
+  if (arguments.read("--trace", traceFile)) {
+    OculusTrace::setOutputFile(traceFile);
+    OculusTrace::enable();
+  }
   // read the scene from the list of file specified command line arguments.
   osg::ref_ptr<osg::Node> loadedModel = osgDB::readNodeFiles(arguments);
 
@@ -51,6 +86,41 @@ int main(int argc, char** argv) {
                                                              mirrorTextureWidth,
                                                              false);
 
+  if (multiview) {
+    oculusDevice->setStereoMode(OculusDevice::StereoMode::MULTIVIEW);
+  } else if (sharedCull) {
+    oculusDevice->setStereoMode(OculusDevice::StereoMode::SHARED_CULL);
+  }
+
+  if (textureArray) {
+    oculusDevice->setTextureLayout(OculusDevice::TextureLayout::TEXTURE_ARRAY);
+  } else if (sideBySide) {
+    oculusDevice->setTextureLayout(OculusDevice::TextureLayout::SIDE_BY_SIDE);
+  }
+
+  if (hiddenAreaMask) {
+    oculusDevice->setHiddenAreaMask(true);
+  }
+
+  if (lateLatching) {
+    oculusDevice->setLateLatching(true);
+  }
+
+  if (dynamicResolution) {
+    oculusDevice->setDynamicResolution(true, 0.5f, true);
+  }
+
+  if (idleWhenNotVisible) {
+    oculusDevice->setIdleWhenNotVisible(true);
+  }
+
+  if (!recordFile.empty()) {
+    // Frames are recorded at the display refresh rate, unless dropped
+    const int frameRate = (int)oculusDevice->hmdDescription().DisplayRefreshRate;
+    oculusDevice->setMirrorCapture(
+      new OculusMirrorCapture(recordFile, OculusMirrorCapture::Y4M, frameRate));
+  }
+
   // Exit if we do not have a valid HMD present
   if (!oculusDevice->hmdPresent()) {
     osg::notify(osg::FATAL) << "Error: No valid HMD present!" << std::endl;
@@ -59,6 +129,12 @@ int main(int argc, char** argv) {
 
   // Get the suggested context traits
   osg::ref_ptr<osg::GraphicsContext::Traits> traits = oculusDevice->graphicsContextTraits();
+
+  if (!traits) {
+    osg::notify(osg::NOTICE) << "Error, unable to get the graphics context traits" << std::endl;
+    return 1;
+  }
+
   traits->windowName = "OsgOculusViewerExample";
 
   // Create a graphic context based on our desired traits
@@ -76,8 +152,11 @@ int main(int argc, char** argv) {
   }
 
   osgViewer::Viewer viewer(arguments);
-  // Force single threaded to make sure that no other thread can use the GL context
-  viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+  // Run single threaded unless a threading model is given, e.g. --DrawThreadPerContext.
+  // The per frame poses let the draw thread submit frame N while frame N+1 is being updated.
+  if (viewer.getThreadingModel() == osgViewer::Viewer::AutomaticSelection) {
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+  }
   viewer.getCamera()->setGraphicsContext(gc.get());
   viewer.getCamera()->setViewport(0, 0, traits->width, traits->height);
 
@@ -98,6 +177,8 @@ int main(int argc, char** argv) {
 
   osg::ref_ptr<OculusViewer> oculusViewer =
     new OculusViewer(&viewer, oculusDevice.get(), oculusRealizeOperation.get());
+  oculusViewer->setParallelCull(parallelCull);
+  oculusViewer->setLODControl(lodControl);
   oculusViewer->addChild(loadedModel.get());
   viewer.setSceneData(oculusViewer.get());
 
@@ -106,10 +187,62 @@ int main(int argc, char** argv) {
     new OculusTouchManipulator(oculusDevice.get());
   viewer.setCameraManipulator(cameraManipulator.get());
 
-  // Add statistics handler
-  viewer.addEventHandler(new osgViewer::StatsHandler);
+  // Add statistics handler, including the GPU times of the frame stages
+  osg::ref_ptr<osgViewer::StatsHandler> statsHandler = new osgViewer::StatsHandler;
+  const osg::Vec4 gpuColor(1.0f, 0.5f, 0.5f, 1.0f);
+  const std::pair<const char*, OculusGpuTimer::Stage> gpuStages[] = {
+    {"Left eye GPU", OculusGpuTimer::LEFT_EYE},
+    {"Right eye GPU", OculusGpuTimer::RIGHT_EYE},
+    {"Both eyes GPU", OculusGpuTimer::BOTH_EYES},
+    {"MSAA resolve GPU", OculusGpuTimer::MSAA_RESOLVE},
+    {"Mirror blit GPU", OculusGpuTimer::MIRROR_BLIT}};
+  for (const auto& stage : gpuStages) {
+    statsHandler->addUserStatsLine(stage.first,
+                                   gpuColor,
+                                   gpuColor,
+                                   OculusGpuTimer::attributeName(stage.second),
+                                   1000.0,
+                                   true,
+                                   false,
+                                   "",
+                                   "",
+                                   0.0);
+  }
+
+  // Add the compositor statistics, times shown in milliseconds
+  const osg::Vec4 compositorColor(0.5f, 1.0f, 0.5f, 1.0f);
+  const std::pair<const char*, double> compositorStats[] = {{"App dropped frames", 1.0},
+                                                            {"Compositor dropped frames", 1.0},
+                                                            {"Motion to photon latency", 1000.0},
+                                                            {"ASW active", 1.0},
+                                                            {"App GPU headroom", 1000.0},
+                                                            {"Compositor GPU time taken", 1000.0},
+                                                            {"Compositor headroom", 1000.0}};
+  for (const auto& attribute : compositorStats) {
+    statsHandler->addUserStatsLine(attribute.first,
+                                   compositorColor,
+                                   compositorColor,
+                                   attribute.first,
+                                   attribute.second,
+                                   false,
+                                   false,
+                                   "",
+                                   "",
+                                   0.0);
+  }
+  viewer.addEventHandler(statsHandler.get());
+
+  // The stats handler only collects the GPU stats of the cameras, while the GPU timers and the
+  // compositor report to the viewer stats
+  viewer.getViewerStats()->collectStats("gpu", true);
+  viewer.getViewerStats()->collectStats("compositor", true);
 
   viewer.addEventHandler(new OculusEventHandler(oculusDevice.get()));
   viewer.run();
+
+  if (OculusTrace::enabled()) {
+    OculusTrace::write();
+  }
+
   return 0;
 }
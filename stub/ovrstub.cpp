@@ -0,0 +1,1073 @@
+/*
+ * ovrstub.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ *
+ *  Stub of the Oculus runtime. It implements the subset of OVR_CAPI.h and OVR_CAPI_GL.h used by
+ *  this project, with swap chains backed by real OpenGL textures, synthetic poses, simulated
+ *  frame pacing and synthetic performance statistics, so the full pipeline can run without a
+ *  headset.
+ */
+
+#include <osg/GLExtensions>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <OVR_CAPI.h>
+#include <OVR_CAPI_GL.h>
+#if defined(__has_include)
+  #if __has_include(<Extras/OVR_CAPI_Util.h>)
+    #include <Extras/OVR_CAPI_Util.h>
+  #endif
+#endif
+
+#include "ovrstub.h"
+
+#ifndef GL_SRGB8_ALPHA8
+  #define GL_SRGB8_ALPHA8 0x8C43
+#endif
+#ifndef GL_RGBA16F
+  #define GL_RGBA16F 0x881A
+#endif
+#ifndef GL_HALF_FLOAT
+  #define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_R11F_G11F_B10F
+  #define GL_R11F_G11F_B10F 0x8C3A
+#endif
+#ifndef GL_UNSIGNED_INT_10F_11F_11F_REV
+  #define GL_UNSIGNED_INT_10F_11F_11F_REV 0x8C3B
+#endif
+#ifndef GL_DEPTH_COMPONENT32F
+  #define GL_DEPTH_COMPONENT32F 0x8CAC
+#endif
+#ifndef GL_DEPTH32F_STENCIL8
+  #define GL_DEPTH32F_STENCIL8 0x8CAD
+#endif
+#ifndef GL_FLOAT_32_UNSIGNED_INT_24_8_REV
+  #define GL_FLOAT_32_UNSIGNED_INT_24_8_REV 0x8DAD
+#endif
+#ifndef GL_DEPTH24_STENCIL8
+  #define GL_DEPTH24_STENCIL8 0x88F0
+#endif
+#ifndef GL_DEPTH_STENCIL
+  #define GL_DEPTH_STENCIL 0x84F9
+#endif
+#ifndef GL_UNSIGNED_INT_24_8
+  #define GL_UNSIGNED_INT_24_8 0x84FA
+#endif
+#ifndef GL_TEXTURE_2D_ARRAY
+  #define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_TEXTURE_CUBE_MAP
+  #define GL_TEXTURE_CUBE_MAP 0x8513
+#endif
+#ifndef GL_TEXTURE_CUBE_MAP_POSITIVE_X
+  #define GL_TEXTURE_CUBE_MAP_POSITIVE_X 0x8515
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+  #define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+  #define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+#ifndef GL_READ_FRAMEBUFFER_BINDING
+  #define GL_READ_FRAMEBUFFER_BINDING 0x8CAA
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER_BINDING
+  #define GL_DRAW_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+  #define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+
+typedef std::chrono::steady_clock StubClock;
+
+// Settings, see ovrstub.h
+static float s_refreshRate = 90.0f;
+static bool s_framePacing = true;
+static bool s_headMotion = true;
+
+// Entry points which are not part of OpenGL 1.1
+struct StubGL {
+  void(GL_APIENTRY* glGenFramebuffers)(GLsizei n, GLuint* ids) = nullptr;
+  void(GL_APIENTRY* glDeleteFramebuffers)(GLsizei n, const GLuint* ids) = nullptr;
+  void(GL_APIENTRY* glBindFramebuffer)(GLenum target, GLuint framebuffer) = nullptr;
+  void(GL_APIENTRY* glFramebufferTexture2D)(GLenum target,
+                                            GLenum attachment,
+                                            GLenum textarget,
+                                            GLuint texture,
+                                            GLint level) = nullptr;
+  void(GL_APIENTRY* glFramebufferTextureLayer)(GLenum target,
+                                               GLenum attachment,
+                                               GLuint texture,
+                                               GLint level,
+                                               GLint layer) = nullptr;
+  void(GL_APIENTRY* glBlitFramebuffer)(GLint srcX0,
+                                       GLint srcY0,
+                                       GLint srcX1,
+                                       GLint srcY1,
+                                       GLint dstX0,
+                                       GLint dstY0,
+                                       GLint dstX1,
+                                       GLint dstY1,
+                                       GLbitfield mask,
+                                       GLenum filter) = nullptr;
+  void(GL_APIENTRY* glTexImage3D)(GLenum target,
+                                  GLint level,
+                                  GLint internalformat,
+                                  GLsizei width,
+                                  GLsizei height,
+                                  GLsizei depth,
+                                  GLint border,
+                                  GLenum format,
+                                  GLenum type,
+                                  const void* pixels) = nullptr;
+  bool loaded = false;
+
+  void load() {
+    if (loaded) {
+      return;
+    }
+
+    osg::setGLExtensionFuncPtr(glGenFramebuffers, "glGenFramebuffers", "glGenFramebuffersEXT");
+    osg::setGLExtensionFuncPtr(glDeleteFramebuffers,
+                               "glDeleteFramebuffers",
+                               "glDeleteFramebuffersEXT");
+    osg::setGLExtensionFuncPtr(glBindFramebuffer, "glBindFramebuffer", "glBindFramebufferEXT");
+    osg::setGLExtensionFuncPtr(glFramebufferTexture2D,
+                               "glFramebufferTexture2D",
+                               "glFramebufferTexture2DEXT");
+    osg::setGLExtensionFuncPtr(glFramebufferTextureLayer,
+                               "glFramebufferTextureLayer",
+                               "glFramebufferTextureLayerEXT");
+    osg::setGLExtensionFuncPtr(glBlitFramebuffer, "glBlitFramebuffer", "glBlitFramebufferEXT");
+    osg::setGLExtensionFuncPtr(glTexImage3D, "glTexImage3D", "glTexImage3DEXT");
+    loaded = true;
+  }
+};
+
+static StubGL s_gl;
+
+struct ovrHmdStruct {
+  // Guards the frame timing, which the update and draw threads of the application both use
+  std::mutex mutex;
+  ovrHmdDesc hmdDesc;
+  ovrTrackingOrigin origin = ovrTrackingOrigin_EyeLevel;
+  StubClock::time_point start;
+  StubClock::time_point nextVsync;
+  StubClock::time_point lastEndFrame;
+  StubClock::time_point lastPoseSample;
+  bool hasEndedFrame = false;
+  double recenterYaw = 0.0;
+  int appDroppedFrames = 0;
+  int compositorFrameIndex = 0;
+  bool anyFrameStatsDropped = false;
+  std::deque<ovrPerfStatsPerCompositorFrame> frameStats;
+  ovrMirrorTexture mirrorTexture = nullptr;
+  GLuint readFBO = 0;
+  GLuint drawFBO = 0;
+};
+
+struct ovrTextureSwapChainData {
+  ovrTextureSwapChainDesc desc;
+  GLenum target;
+  std::vector<GLuint> textures;
+  int currentIndex;
+  int committedIndex;  // image shown by the compositor, -1 until the first commit
+};
+
+struct ovrMirrorTextureData {
+  ovrMirrorTextureDesc desc;
+  GLuint texture;
+};
+
+static double elapsedSeconds(StubClock::time_point from, StubClock::time_point to) {
+  return std::chrono::duration<double>(to - from).count();
+}
+
+static StubClock::duration framePeriod() {
+  return std::chrono::duration_cast<StubClock::duration>(
+    std::chrono::duration<double>(1.0 / s_refreshRate));
+}
+
+static void readEnvironment() {
+  if (const char* value = std::getenv("OVR_STUB_REFRESH_RATE")) {
+    const float refreshRate = (float)std::atof(value);
+    if (refreshRate > 0.0f) {
+      s_refreshRate = refreshRate;
+    }
+  }
+
+  if (const char* value = std::getenv("OVR_STUB_FRAME_PACING")) {
+    s_framePacing = std::atoi(value) != 0;
+  }
+
+  if (const char* value = std::getenv("OVR_STUB_HEAD_MOTION")) {
+    s_headMotion = std::atoi(value) != 0;
+  }
+}
+
+static ovrQuatf quatMultiply(const ovrQuatf& a, const ovrQuatf& b) {
+  ovrQuatf q;
+  q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return q;
+}
+
+static ovrVector3f quatRotate(const ovrQuatf& q, const ovrVector3f& v) {
+  const ovrQuatf p = {v.x, v.y, v.z, 0.0f};
+  const ovrQuatf conjugate = {-q.x, -q.y, -q.z, q.w};
+  const ovrQuatf r = quatMultiply(quatMultiply(q, p), conjugate);
+  const ovrVector3f result = {r.x, r.y, r.z};
+  return result;
+}
+
+static ovrQuatf axisAngle(float x, float y, float z, double angle) {
+  const float s = (float)std::sin(angle * 0.5);
+  const ovrQuatf q = {x * s, y * s, z * s, (float)std::cos(angle * 0.5)};
+  return q;
+}
+
+static ovrPosef headPose(ovrSession session, double time) {
+  ovrPosef pose;
+  pose.Position.x = 0.0f;
+  pose.Position.y = session->origin == ovrTrackingOrigin_FloorLevel ? 1.7f : 0.0f;
+  pose.Position.z = 0.0f;
+
+  double yaw = -session->recenterYaw;
+  double pitch = 0.0;
+  if (s_headMotion) {
+    yaw += 0.35 * std::sin(0.5 * time);
+    pitch = 0.1 * std::sin(0.3 * time);
+  }
+
+  pose.Orientation = quatMultiply(axisAngle(0.0f, 1.0f, 0.0f, yaw), axisAngle(1.0f, 0.0f, 0.0f, pitch));
+  return pose;
+}
+
+static ovrPoseStatef poseState(const ovrPosef& pose, double time) {
+  ovrPoseStatef state;
+  std::memset(&state, 0, sizeof(state));
+  state.ThePose = pose;
+  state.TimeInSeconds = time;
+  return state;
+}
+
+static void textureFormat(ovrTextureFormat format,
+                          GLenum& internalFormat,
+                          GLenum& pixelFormat,
+                          GLenum& type) {
+  pixelFormat = GL_RGBA;
+  type = GL_UNSIGNED_BYTE;
+
+  switch (format) {
+    case OVR_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case OVR_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case OVR_FORMAT_B8G8R8X8_UNORM_SRGB:
+      internalFormat = GL_SRGB8_ALPHA8;
+      break;
+    case OVR_FORMAT_R16G16B16A16_FLOAT:
+      internalFormat = GL_RGBA16F;
+      type = GL_HALF_FLOAT;
+      break;
+    case OVR_FORMAT_R11G11B10_FLOAT:
+      internalFormat = GL_R11F_G11F_B10F;
+      pixelFormat = GL_RGB;
+      type = GL_UNSIGNED_INT_10F_11F_11F_REV;
+      break;
+    case OVR_FORMAT_D16_UNORM:
+      internalFormat = GL_DEPTH_COMPONENT16;
+      pixelFormat = GL_DEPTH_COMPONENT;
+      type = GL_UNSIGNED_SHORT;
+      break;
+    case OVR_FORMAT_D24_UNORM_S8_UINT:
+      internalFormat = GL_DEPTH24_STENCIL8;
+      pixelFormat = GL_DEPTH_STENCIL;
+      type = GL_UNSIGNED_INT_24_8;
+      break;
+    case OVR_FORMAT_D32_FLOAT:
+      internalFormat = GL_DEPTH_COMPONENT32F;
+      pixelFormat = GL_DEPTH_COMPONENT;
+      type = GL_FLOAT;
+      break;
+    case OVR_FORMAT_D32_FLOAT_S8X24_UINT:
+      internalFormat = GL_DEPTH32F_STENCIL8;
+      pixelFormat = GL_DEPTH_STENCIL;
+      type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+      break;
+    default:
+      internalFormat = GL_RGBA8;
+      break;
+  }
+}
+
+static GLuint createTexture(const ovrTextureSwapChainDesc& desc, GLenum target) {
+  GLenum internalFormat, pixelFormat, type;
+  textureFormat(desc.Format, internalFormat, pixelFormat, type);
+
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(target, texture);
+
+  if (target == GL_TEXTURE_2D_ARRAY) {
+    s_gl.glTexImage3D(target,
+                      0,
+                      internalFormat,
+                      desc.Width,
+                      desc.Height,
+                      desc.ArraySize,
+                      0,
+                      pixelFormat,
+                      type,
+                      nullptr);
+  } else if (target == GL_TEXTURE_CUBE_MAP) {
+    for (int face = 0; face < 6; ++face) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                   0,
+                   internalFormat,
+                   desc.Width,
+                   desc.Height,
+                   0,
+                   pixelFormat,
+                   type,
+                   nullptr);
+    }
+  } else {
+    glTexImage2D(target,
+                 0,
+                 internalFormat,
+                 desc.Width,
+                 desc.Height,
+                 0,
+                 pixelFormat,
+                 type,
+                 nullptr);
+  }
+
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(target, 0);
+  return texture;
+}
+
+// Copies the eye images of a layer to the mirror texture, which is the only composition the stub
+// does. It keeps the cost of the compositor reading the swap chains in the measurements.
+static void composeMirror(ovrSession session, const ovrLayerEyeFov& layer) {
+  const ovrMirrorTexture mirror = session->mirrorTexture;
+  if (!mirror || !s_gl.glBlitFramebuffer || !s_gl.glFramebufferTextureLayer) {
+    return;
+  }
+
+  GLint readFramebuffer = 0;
+  GLint drawFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+
+  if (!session->readFBO) {
+    s_gl.glGenFramebuffers(1, &session->readFBO);
+    s_gl.glGenFramebuffers(1, &session->drawFBO);
+  }
+
+  s_gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, session->drawFBO);
+  s_gl.glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,
+                              GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D,
+                              mirror->texture,
+                              0);
+  s_gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, session->readFBO);
+
+  const int mirrorWidth = mirror->desc.Width;
+  const int mirrorHeight = mirror->desc.Height;
+  const bool originAtBottomLeft = (layer.Header.Flags & ovrLayerFlag_TextureOriginAtBottomLeft) != 0;
+
+  for (int eye = 0; eye < 2; ++eye) {
+    // A missing right eye texture means that both eyes share the left eye texture
+    const bool shared = layer.ColorTexture[1] == nullptr;
+    const ovrTextureSwapChain chain = shared ? layer.ColorTexture[0] : layer.ColorTexture[eye];
+
+    if (!chain || chain->committedIndex < 0) {
+      continue;
+    }
+
+    const GLuint texture = chain->textures[chain->committedIndex];
+    if (chain->target == GL_TEXTURE_2D_ARRAY) {
+      s_gl.glFramebufferTextureLayer(GL_READ_FRAMEBUFFER,
+                                     GL_COLOR_ATTACHMENT0,
+                                     texture,
+                                     0,
+                                     shared ? eye : 0);
+    } else {
+      s_gl.glFramebufferTexture2D(GL_READ_FRAMEBUFFER,
+                                  GL_COLOR_ATTACHMENT0,
+                                  GL_TEXTURE_2D,
+                                  texture,
+                                  0);
+    }
+
+    const ovrRecti& viewport = layer.Viewport[eye];
+    const int x0 = eye * mirrorWidth / 2;
+    const int x1 = (eye + 1) * mirrorWidth / 2;
+
+    // The mirror texture has its origin in the top left corner, like the real runtime
+    s_gl.glBlitFramebuffer(viewport.Pos.x,
+                           viewport.Pos.y,
+                           viewport.Pos.x + viewport.Size.w,
+                           viewport.Pos.y + viewport.Size.h,
+                           x0,
+                           originAtBottomLeft ? mirrorHeight : 0,
+                           x1,
+                           originAtBottomLeft ? 0 : mirrorHeight,
+                           GL_COLOR_BUFFER_BIT,
+                           GL_LINEAR);
+  }
+
+  s_gl.glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+  s_gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+}
+
+void ovrStub_SetDisplayRefreshRate(float refreshRate) {
+  if (refreshRate > 0.0f) {
+    s_refreshRate = refreshRate;
+  }
+}
+
+void ovrStub_SetFramePacing(bool enabled) {
+  s_framePacing = enabled;
+}
+
+void ovrStub_SetHeadMotion(bool enabled) {
+  s_headMotion = enabled;
+}
+
+/* Session */
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_Initialize(const ovrInitParams* params) {
+  (void)params;
+  readEnvironment();
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_Shutdown() {}
+
+OVR_PUBLIC_FUNCTION(void) ovr_GetLastErrorInfo(ovrErrorInfo* errorInfo) {
+  if (errorInfo) {
+    std::memset(errorInfo, 0, sizeof(*errorInfo));
+    errorInfo->Result = ovrSuccess;
+  }
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_Create(ovrSession* pSession, ovrGraphicsLuid* pLuid) {
+  ovrSession session = new ovrHmdStruct();
+
+  // A headset resembling the Rift CV1
+  ovrHmdDesc& desc = session->hmdDesc;
+  std::memset(&desc, 0, sizeof(desc));
+  desc.Type = ovrHmd_CV1;
+  std::strncpy(desc.ProductName, "Oculus Stub", sizeof(desc.ProductName) - 1);
+  std::strncpy(desc.Manufacturer, "OsgOculusViewer", sizeof(desc.Manufacturer) - 1);
+  std::strncpy(desc.SerialNumber, "STUB0000", sizeof(desc.SerialNumber) - 1);
+  desc.Resolution.w = 2160;
+  desc.Resolution.h = 1200;
+  desc.DisplayRefreshRate = s_refreshRate;
+
+  for (int eye = 0; eye < 2; ++eye) {
+    ovrFovPort fov;
+    fov.UpTan = 1.329f;
+    fov.DownTan = 1.329f;
+    fov.LeftTan = eye == ovrEye_Left ? 1.058f : 1.092f;
+    fov.RightTan = eye == ovrEye_Left ? 1.092f : 1.058f;
+    desc.DefaultEyeFov[eye] = fov;
+    desc.MaxEyeFov[eye] = fov;
+  }
+
+  session->start = StubClock::now();
+  session->nextVsync = session->start + framePeriod();
+  session->lastPoseSample = session->start;
+
+  if (pLuid) {
+    std::memset(pLuid, 0, sizeof(*pLuid));
+  }
+
+  *pSession = session;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_Destroy(ovrSession session) {
+  if (session && session->readFBO && s_gl.glDeleteFramebuffers) {
+    s_gl.glDeleteFramebuffers(1, &session->readFBO);
+    s_gl.glDeleteFramebuffers(1, &session->drawFBO);
+  }
+
+  delete session;
+}
+
+OVR_PUBLIC_FUNCTION(ovrHmdDesc) ovr_GetHmdDesc(ovrSession session) {
+  if (!session) {
+    ovrHmdDesc desc;
+    std::memset(&desc, 0, sizeof(desc));
+    return desc;
+  }
+
+  return session->hmdDesc;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetSessionStatus(ovrSession session,
+                                                    ovrSessionStatus* sessionStatus) {
+  if (!session || !sessionStatus) {
+    return ovrError_InvalidSession;
+  }
+
+  std::memset(sessionStatus, 0, sizeof(*sessionStatus));
+  sessionStatus->IsVisible = ovrTrue;
+  sessionStatus->HmdPresent = ovrTrue;
+  sessionStatus->HmdMounted = ovrTrue;
+  sessionStatus->HasInputFocus = ovrTrue;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrBool) ovr_SetInt(ovrSession session, const char* propertyName, int value) {
+  (void)session;
+  (void)propertyName;
+  (void)value;
+  return ovrTrue;
+}
+
+/* Tracking */
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_SetTrackingOriginType(ovrSession session,
+                                                         ovrTrackingOrigin origin) {
+  session->origin = origin;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_RecenterTrackingOrigin(ovrSession session) {
+  if (s_headMotion) {
+    session->recenterYaw = 0.35 * std::sin(0.5 * elapsedSeconds(session->start, StubClock::now()));
+  }
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrTrackingState) ovr_GetTrackingState(ovrSession session,
+                                                           double absTime,
+                                                           ovrBool latencyMarker) {
+  (void)latencyMarker;
+  const double now = elapsedSeconds(session->start, StubClock::now());
+  const double time = absTime > 0.0 ? absTime : now;
+
+  ovrTrackingState state;
+  std::memset(&state, 0, sizeof(state));
+  state.HeadPose = poseState(headPose(session, time), time);
+  state.StatusFlags = ovrStatus_OrientationTracked | ovrStatus_PositionTracked;
+
+  for (int hand = 0; hand < 2; ++hand) {
+    ovrPosef pose = headPose(session, time);
+    pose.Position.x += hand == ovrHand_Left ? -0.2f : 0.2f;
+    pose.Position.y -= 0.3f;
+    pose.Position.z -= 0.3f;
+    state.HandPoses[hand] = poseState(pose, time);
+  }
+
+  return state;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_GetEyePoses(ovrSession session,
+                                          long long frameIndex,
+                                          ovrBool latencyMarker,
+                                          const ovrPosef hmdToEyePose[2],
+                                          ovrPosef outEyePoses[2],
+                                          double* outSensorSampleTime) {
+  (void)frameIndex;
+  (void)latencyMarker;
+  const StubClock::time_point now = StubClock::now();
+  {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->lastPoseSample = now;
+  }
+  const double time = elapsedSeconds(session->start, now);
+  const ovrPosef head = headPose(session, time);
+
+  for (int eye = 0; eye < 2; ++eye) {
+    const ovrVector3f offset = quatRotate(head.Orientation, hmdToEyePose[eye].Position);
+    outEyePoses[eye].Position.x = head.Position.x + offset.x;
+    outEyePoses[eye].Position.y = head.Position.y + offset.y;
+    outEyePoses[eye].Position.z = head.Position.z + offset.z;
+    outEyePoses[eye].Orientation = quatMultiply(head.Orientation, hmdToEyePose[eye].Orientation);
+  }
+
+  if (outSensorSampleTime) {
+    *outSensorSampleTime = time;
+  }
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetInputState(ovrSession session,
+                                                 ovrControllerType controllerType,
+                                                 ovrInputState* inputState) {
+  (void)session;
+  (void)controllerType;
+
+  if (inputState) {
+    // No controllers are connected
+    std::memset(inputState, 0, sizeof(*inputState));
+  }
+
+  return ovrSuccess;
+}
+
+/* Rendering */
+
+OVR_PUBLIC_FUNCTION(ovrSizei) ovr_GetFovTextureSize(ovrSession session,
+                                                    ovrEyeType eye,
+                                                    ovrFovPort fov,
+                                                    float pixelsPerDisplayPixel) {
+  (void)session;
+  (void)eye;
+
+  // Pixel density at the center of the simulated lens
+  const float pixelsPerTanAngle = 625.0f * pixelsPerDisplayPixel;
+
+  ovrSizei size;
+  size.w = (int)std::ceil((fov.LeftTan + fov.RightTan) * pixelsPerTanAngle);
+  size.h = (int)std::ceil((fov.UpTan + fov.DownTan) * pixelsPerTanAngle);
+  return size;
+}
+
+OVR_PUBLIC_FUNCTION(ovrEyeRenderDesc) ovr_GetRenderDesc(ovrSession session,
+                                                        ovrEyeType eyeType,
+                                                        ovrFovPort fov) {
+  ovrEyeRenderDesc desc;
+  std::memset(&desc, 0, sizeof(desc));
+  desc.Eye = eyeType;
+  desc.Fov = fov;
+  desc.DistortedViewport.Size.w = session->hmdDesc.Resolution.w / 2;
+  desc.DistortedViewport.Size.h = session->hmdDesc.Resolution.h;
+  desc.DistortedViewport.Pos.x = eyeType == ovrEye_Left ? 0 : desc.DistortedViewport.Size.w;
+  desc.PixelsPerTanAngleAtCenter.x = 625.0f;
+  desc.PixelsPerTanAngleAtCenter.y = 625.0f;
+
+  // 64 mm interpupillary distance
+  desc.HmdToEyePose.Position.x = eyeType == ovrEye_Left ? -0.032f : 0.032f;
+  desc.HmdToEyePose.Orientation.w = 1.0f;
+  return desc;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetFovStencil(ovrSession session,
+                                                 const ovrFovStencilDesc* fovStencilDesc,
+                                                 ovrFovStencilMeshBuffer* meshBuffer) {
+  (void)session;
+
+  if (!fovStencilDesc || !meshBuffer) {
+    return ovrError_InvalidParameter;
+  }
+
+  // The hidden area is the part of the viewport outside the inscribed ellipse of the lens,
+  // built from one quad per segment between the ellipse and the viewport border.
+  const int segments = fovStencilDesc->StencilType == ovrFovStencil_HiddenArea ? 32 : 0;
+  meshBuffer->UsedVertexCount = segments * 2;
+  meshBuffer->UsedIndexCount = segments * 6;
+
+  if (segments == 0 || !meshBuffer->VertexBuffer || !meshBuffer->IndexBuffer) {
+    return ovrSuccess;
+  }
+
+  if (meshBuffer->AllocVertexCount < meshBuffer->UsedVertexCount ||
+      meshBuffer->AllocIndexCount < meshBuffer->UsedIndexCount) {
+    return ovrError_InvalidParameter;
+  }
+
+  const double pi = 3.14159265358979323846;
+  for (int i = 0; i < segments; ++i) {
+    const double angle = 2.0 * pi * i / segments;
+    const double x = std::cos(angle);
+    const double y = std::sin(angle);
+    const double border = 1.0 / std::max(std::fabs(x), std::fabs(y));
+
+    meshBuffer->VertexBuffer[2 * i].x = (float)(0.5 + 0.5 * x);
+    meshBuffer->VertexBuffer[2 * i].y = (float)(0.5 + 0.5 * y);
+    meshBuffer->VertexBuffer[2 * i + 1].x = (float)(0.5 + 0.5 * x * border);
+    meshBuffer->VertexBuffer[2 * i + 1].y = (float)(0.5 + 0.5 * y * border);
+
+    const uint16_t inner = (uint16_t)(2 * i);
+    const uint16_t outer = (uint16_t)(2 * i + 1);
+    const uint16_t nextInner = (uint16_t)(2 * ((i + 1) % segments));
+    const uint16_t nextOuter = (uint16_t)(2 * ((i + 1) % segments) + 1);
+    uint16_t* indices = meshBuffer->IndexBuffer + 6 * i;
+    indices[0] = inner;
+    indices[1] = outer;
+    indices[2] = nextOuter;
+    indices[3] = inner;
+    indices[4] = nextOuter;
+    indices[5] = nextInner;
+  }
+
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateTextureSwapChainGL(ovrSession session,
+                                                            const ovrTextureSwapChainDesc* desc,
+                                                            ovrTextureSwapChain* outTextureSwapChain) {
+  (void)session;
+
+  if (!desc || !outTextureSwapChain) {
+    return ovrError_InvalidParameter;
+  }
+
+  s_gl.load();
+
+  ovrTextureSwapChain chain = new ovrTextureSwapChainData();
+  chain->desc = *desc;
+  chain->currentIndex = 0;
+  chain->committedIndex = -1;
+
+  if (desc->Type == ovrTexture_Cube) {
+    chain->target = GL_TEXTURE_CUBE_MAP;
+  } else if (desc->ArraySize > 1) {
+    chain->target = GL_TEXTURE_2D_ARRAY;
+  } else {
+    chain->target = GL_TEXTURE_2D;
+  }
+
+  // Static images only need one buffer, like in the real runtime
+  const int length = desc->StaticImage ? 1 : 3;
+  for (int i = 0; i < length; ++i) {
+    chain->textures.push_back(createTexture(*desc, chain->target));
+  }
+
+  *outTextureSwapChain = chain;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainBufferGL(ovrSession session,
+                                                               ovrTextureSwapChain chain,
+                                                               int index,
+                                                               unsigned int* outTexId) {
+  (void)session;
+
+  if (!chain || !outTexId) {
+    return ovrError_InvalidParameter;
+  }
+
+  if (index < 0) {
+    index = chain->currentIndex;
+  }
+
+  if (index >= (int)chain->textures.size()) {
+    return ovrError_InvalidParameter;
+  }
+
+  *outTexId = chain->textures[index];
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainLength(ovrSession session,
+                                                             ovrTextureSwapChain chain,
+                                                             int* outLength) {
+  (void)session;
+
+  if (!chain || !outLength) {
+    return ovrError_InvalidParameter;
+  }
+
+  *outLength = (int)chain->textures.size();
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainCurrentIndex(ovrSession session,
+                                                                   ovrTextureSwapChain chain,
+                                                                   int* outIndex) {
+  (void)session;
+
+  if (!chain || !outIndex) {
+    return ovrError_InvalidParameter;
+  }
+
+  *outIndex = chain->currentIndex;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainDesc(ovrSession session,
+                                                           ovrTextureSwapChain chain,
+                                                           ovrTextureSwapChainDesc* outDesc) {
+  (void)session;
+
+  if (!chain || !outDesc) {
+    return ovrError_InvalidParameter;
+  }
+
+  *outDesc = chain->desc;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CommitTextureSwapChain(ovrSession session,
+                                                          ovrTextureSwapChain chain) {
+  (void)session;
+
+  if (!chain) {
+    return ovrError_InvalidParameter;
+  }
+
+  chain->committedIndex = chain->currentIndex;
+  chain->currentIndex = (chain->currentIndex + 1) % (int)chain->textures.size();
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_DestroyTextureSwapChain(ovrSession session,
+                                                      ovrTextureSwapChain chain) {
+  (void)session;
+
+  if (!chain) {
+    return;
+  }
+
+  if (!chain->textures.empty()) {
+    glDeleteTextures((GLsizei)chain->textures.size(), chain->textures.data());
+  }
+
+  delete chain;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateMirrorTextureWithOptionsGL(
+  ovrSession session,
+  const ovrMirrorTextureDesc* desc,
+  ovrMirrorTexture* outMirrorTexture) {
+  if (!desc || !outMirrorTexture) {
+    return ovrError_InvalidParameter;
+  }
+
+  s_gl.load();
+
+  ovrMirrorTexture mirror = new ovrMirrorTextureData();
+  mirror->desc = *desc;
+
+  ovrTextureSwapChainDesc textureDesc = {};
+  textureDesc.Type = ovrTexture_2D;
+  textureDesc.Format = desc->Format;
+  textureDesc.ArraySize = 1;
+  textureDesc.Width = desc->Width;
+  textureDesc.Height = desc->Height;
+  textureDesc.MipLevels = 1;
+  textureDesc.SampleCount = 1;
+  mirror->texture = createTexture(textureDesc, GL_TEXTURE_2D);
+
+  session->mirrorTexture = mirror;
+  *outMirrorTexture = mirror;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateMirrorTextureGL(ovrSession session,
+                                                         const ovrMirrorTextureDesc* desc,
+                                                         ovrMirrorTexture* outMirrorTexture) {
+  return ovr_CreateMirrorTextureWithOptionsGL(session, desc, outMirrorTexture);
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetMirrorTextureBufferGL(ovrSession session,
+                                                            ovrMirrorTexture mirrorTexture,
+                                                            unsigned int* outTexId) {
+  (void)session;
+
+  if (!mirrorTexture || !outTexId) {
+    return ovrError_InvalidParameter;
+  }
+
+  *outTexId = mirrorTexture->texture;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_DestroyMirrorTexture(ovrSession session,
+                                                   ovrMirrorTexture mirrorTexture) {
+  if (!mirrorTexture) {
+    return;
+  }
+
+  if (session && session->mirrorTexture == mirrorTexture) {
+    session->mirrorTexture = nullptr;
+  }
+
+  glDeleteTextures(1, &mirrorTexture->texture);
+  delete mirrorTexture;
+}
+
+/* Frame timing */
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_WaitToBeginFrame(ovrSession session, long long frameIndex) {
+  (void)frameIndex;
+
+  if (!s_framePacing) {
+    return ovrSuccess;
+  }
+
+  // Wait for the next simulated vertical sync, skipping the ones already missed
+  StubClock::time_point vsync;
+  {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    const StubClock::duration period = framePeriod();
+    const StubClock::time_point now = StubClock::now();
+    while (session->nextVsync < now) {
+      session->nextVsync += period;
+    }
+
+    vsync = session->nextVsync;
+    session->nextVsync += period;
+  }
+
+  std::this_thread::sleep_until(vsync);
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_BeginFrame(ovrSession session, long long frameIndex) {
+  (void)session;
+  (void)frameIndex;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_EndFrame(ovrSession session,
+                                            long long frameIndex,
+                                            const ovrViewScaleDesc* viewScaleDesc,
+                                            ovrLayerHeader const* const* layerPtrList,
+                                            unsigned int layerCount) {
+  (void)viewScaleDesc;
+  const StubClock::time_point compositorStart = StubClock::now();
+
+  for (unsigned int i = 0; i < layerCount; ++i) {
+    const ovrLayerHeader* header = layerPtrList[i];
+    if (header &&
+        (header->Type == ovrLayerType_EyeFov || header->Type == ovrLayerType_EyeFovDepth)) {
+      // Both layer types start with the members of ovrLayerEyeFov
+      composeMirror(session, *reinterpret_cast<const ovrLayerEyeFov*>(header));
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(session->mutex);
+  const StubClock::time_point now = StubClock::now();
+  const double period = 1.0 / s_refreshRate;
+  const double interval =
+    session->hasEndedFrame ? elapsedSeconds(session->lastEndFrame, now) : period;
+
+  // Frames taking more than one and a half refresh intervals count as dropped
+  if (interval > 1.5 * period) {
+    session->appDroppedFrames += (int)std::floor(interval / period + 0.5) - 1;
+  }
+
+  ovrPerfStatsPerCompositorFrame stats;
+  std::memset(&stats, 0, sizeof(stats));
+  stats.HmdVsyncIndex = session->compositorFrameIndex;
+  stats.AppFrameIndex = (int)frameIndex;
+  stats.AppDroppedFrameCount = session->appDroppedFrames;
+  stats.AppMotionToPhotonLatency = (float)(elapsedSeconds(session->lastPoseSample, now) + period);
+  stats.AppCpuElapsedTime = (float)interval;
+  stats.CompositorFrameIndex = session->compositorFrameIndex++;
+  stats.CompositorCpuElapsedTime = (float)elapsedSeconds(compositorStart, now);
+  stats.CompositorGpuEndToVsyncElapsedTime =
+    s_framePacing ? (float)std::max(0.0, elapsedSeconds(now, session->nextVsync)) : 0.0f;
+
+  session->frameStats.push_front(stats);
+  while (session->frameStats.size() > ovrMaxProvidedFrameStats) {
+    session->frameStats.pop_back();
+    session->anyFrameStatsDropped = true;
+  }
+
+  session->lastEndFrame = now;
+  session->hasEndedFrame = true;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetPerfStats(ovrSession session, ovrPerfStats* outStats) {
+  if (!session || !outStats) {
+    return ovrError_InvalidParameter;
+  }
+
+  std::lock_guard<std::mutex> lock(session->mutex);
+  std::memset(outStats, 0, sizeof(*outStats));
+  outStats->FrameStatsCount = (int)session->frameStats.size();
+  outStats->AnyFrameStatsDropped = session->anyFrameStatsDropped ? ovrTrue : ovrFalse;
+  outStats->AswIsAvailable = ovrFalse;
+
+  for (int i = 0; i < outStats->FrameStatsCount; ++i) {
+    outStats->FrameStats[i] = session->frameStats[i];
+  }
+
+  // The GPU work scale which would make the application frame interval match the display
+  outStats->AdaptiveGpuPerformanceScale = 1.0f;
+  if (outStats->FrameStatsCount > 0 && outStats->FrameStats[0].AppCpuElapsedTime > 0.0f) {
+    const float scale = (1.0f / s_refreshRate) / outStats->FrameStats[0].AppCpuElapsedTime;
+    outStats->AdaptiveGpuPerformanceScale = std::min(std::max(scale, 0.25f), 4.0f);
+  }
+
+  session->frameStats.clear();
+  session->anyFrameStatsDropped = false;
+  return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_ResetPerfStats(ovrSession session) {
+  std::lock_guard<std::mutex> lock(session->mutex);
+  session->frameStats.clear();
+  session->appDroppedFrames = 0;
+  return ovrSuccess;
+}
+
+/* Utilities normally provided by the LibOVR static library */
+
+OVR_PUBLIC_FUNCTION(ovrMatrix4f) ovrMatrix4f_Projection(ovrFovPort fov,
+                                                        float znear,
+                                                        float zfar,
+                                                        unsigned int projectionModFlags) {
+  const bool leftHanded = (projectionModFlags & ovrProjection_LeftHanded) != 0;
+  const bool flipZ = (projectionModFlags & ovrProjection_FarLessThanNear) != 0;
+  const bool farAtInfinity = (projectionModFlags & ovrProjection_FarClipAtInfinity) != 0;
+  const bool isOpenGL = (projectionModFlags & ovrProjection_ClipRangeOpenGL) != 0;
+
+  if (flipZ) {
+    std::swap(znear, zfar);
+  }
+
+  const float projXScale = 2.0f / (fov.LeftTan + fov.RightTan);
+  const float projXOffset = (fov.LeftTan - fov.RightTan) * projXScale * 0.5f;
+  const float projYScale = 2.0f / (fov.UpTan + fov.DownTan);
+  const float projYOffset = (fov.UpTan - fov.DownTan) * projYScale * 0.5f;
+  const float handednessScale = leftHanded ? 1.0f : -1.0f;
+
+  ovrMatrix4f projection;
+  std::memset(&projection, 0, sizeof(projection));
+  projection.M[0][0] = projXScale;
+  projection.M[0][2] = handednessScale * projXOffset;
+  projection.M[1][1] = projYScale;
+  projection.M[1][2] = handednessScale * -projYOffset;
+
+  if (farAtInfinity) {
+    projection.M[2][2] = -handednessScale;
+    projection.M[2][3] = (isOpenGL ? -2.0f : -1.0f) * znear;
+  } else if (isOpenGL) {
+    projection.M[2][2] = -handednessScale * (zfar + znear) / (znear - zfar);
+    projection.M[2][3] = 2.0f * zfar * znear / (znear - zfar);
+  } else {
+    projection.M[2][2] = -handednessScale * zfar / (znear - zfar);
+    projection.M[2][3] = zfar * znear / (znear - zfar);
+  }
+
+  projection.M[3][2] = handednessScale;
+  return projection;
+}
+
+OVR_PUBLIC_FUNCTION(ovrTimewarpProjectionDesc)
+ovrTimewarpProjectionDesc_FromProjection(ovrMatrix4f projection,
+                                         unsigned int projectionModFlags) {
+  (void)projectionModFlags;
+
+  ovrTimewarpProjectionDesc desc;
+  desc.Projection22 = projection.M[2][2];
+  desc.Projection23 = projection.M[2][3];
+  desc.Projection32 = projection.M[3][2];
+  return desc;
+}
@@ -0,0 +1,24 @@
+/*
+ * ovrstub.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Bjorn Blissing
+ */
+
+#ifndef _OSG_OVRSTUB_H_
+#define _OSG_OVRSTUB_H_
+
+// Settings of the stub runtime, which implements the parts of the Oculus runtime used by this
+// project without a headset. The settings can also be given by the environment variables
+// OVR_STUB_REFRESH_RATE, OVR_STUB_FRAME_PACING and OVR_STUB_HEAD_MOTION, read by ovr_Initialize.
+
+// Refresh rate of the simulated display in Hz, 90 by default
+void ovrStub_SetDisplayRefreshRate(float refreshRate);
+
+// Let ovr_WaitToBeginFrame wait for the next simulated vertical sync, enabled by default
+void ovrStub_SetFramePacing(bool enabled);
+
+// Move the simulated head slowly from side to side, enabled by default
+void ovrStub_SetHeadMotion(bool enabled);
+
+#endif /* _OSG_OVRSTUB_H_ */